@@ -3,3 +3,4 @@ set -ex
 
 cd tests/unit
 ../singlerod/short/build/install/bin/unittests
+mpirun -np 3 ../singlerod/short/build/install/bin/unittests
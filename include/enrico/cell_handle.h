@@ -1,6 +1,8 @@
 #ifndef ENRICO_CELL_HANDLE_H
 #define ENRICO_CELL_HANDLE_H
 
+#include <cstddef>
+
 namespace enrico {
 using CellHandle = std::size_t;
 }
@@ -0,0 +1,35 @@
+//! \file cell_record.h
+//! A cell-averaged field value with what the neutronics root needs to accumulate it
+#ifndef ENRICO_CELL_RECORD_H
+#define ENRICO_CELL_RECORD_H
+
+#include "enrico/cell_handle.h"
+#include "enrico/mpi_types.h"
+
+#include <tuple>
+
+namespace enrico {
+
+//! One local cell of a heat rank, as sent to the neutronics root when updating
+//! temperatures or densities.  Sending the fields as one record takes one message per
+//! heat rank instead of one per field.
+struct CellRecord {
+  CellHandle cell = 0; //!< Global cell handle
+  double value = 0.0;  //!< Cell-averaged temperature or density
+  double volume = 0.0; //!< Volume of the cell's elements on the heat rank
+  int fluid = 0;       //!< 1 if the cell is in the fluid, 0 otherwise
+};
+
+//! Cell records are sent as a cell handle, two doubles, and an int
+template<>
+struct MpiRecord<CellRecord> {
+  static auto members()
+  {
+    return std::make_tuple(
+      &CellRecord::cell, &CellRecord::value, &CellRecord::volume, &CellRecord::fluid);
+  }
+};
+
+} // namespace enrico
+
+#endif // ENRICO_CELL_RECORD_H
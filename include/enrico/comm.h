@@ -3,17 +3,32 @@
 #ifndef ENRICO_COMM_H
 #define ENRICO_COMM_H
 
+#include "enrico/comm_counters.h"
+#include "enrico/compression.h"
 #include "enrico/mpi_types.h"
 #include "xtensor/xtensor.hpp"
 
 #include <mpi.h>
 
+#include <algorithm> // for copy, copy_n, max
+#include <array>
+#include <cstddef>
 #include <iostream>
+#include <numeric> // for accumulate
+#include <set>
+#include <sstream>
 #include <string>
+#include <utility> // for swap
 #include <vector>
 
 namespace enrico {
 
+//! A value and the rank it came from, laid out as MPI_DOUBLE_INT
+struct ValueRank {
+  double value;
+  int rank;
+};
+
 //! Info and function wrappers for a specified MPI communictor.
 class Comm {
 public:
@@ -56,7 +71,11 @@ public:
   //! Block until all processes have reached this call
   //!
   //! \return Error value
-  int Barrier() const { return MPI_Barrier(comm); }
+  int Barrier() const
+  {
+    auto counted = comm_counters.count("barrier");
+    return MPI_Barrier(comm);
+  }
 
   //! Broadcasts a message from the process with rank "root" to all other processes in
   //! this comm.
@@ -127,6 +146,347 @@ public:
                      xt::xtensor<T, N>& sendbuf,
                      int source) const;
 
+  //! Send a vector from one rank to another when the destination knows its size.
+  //! Unlike the overload without a count, only the data is sent.
+  //! \param recvbuf Receive buffer, resized to count (significant at destination)
+  //! \param dest Destination rank
+  //! \param sendbuf Send buffer, with count values (significant at source)
+  //! \param source Source rank
+  //! \param count Number of values sent (significant at destination)
+  template<typename T>
+  void send_and_recv(std::vector<T>& recvbuf,
+                     int dest,
+                     std::vector<T>& sendbuf,
+                     int source,
+                     std::size_t count) const;
+
+  //! Send an xtensor from one rank to another when the destination knows its shape.
+  //! Unlike the overload without a shape, only the data is sent.
+  //! \param recvbuf Receive buffer, resized to shape (significant at destination)
+  //! \param dest Destination rank
+  //! \param sendbuf Send buffer, with the given shape (significant at source)
+  //! \param source Source rank
+  //! \param shape Shape of the values sent (significant at destination)
+  template<typename T, size_t N>
+  void send_and_recv(xt::xtensor<T, N>& recvbuf,
+                     int dest,
+                     xt::xtensor<T, N>& sendbuf,
+                     int source,
+                     const std::array<std::size_t, N>& shape) const;
+
+  //! Send a vector from one rank to another, resizing it at destination.  Unlike
+  //! send_and_recv, the size is not sent in its own message; the destination finds it
+  //! by probing the data message.
+  //! \param recvbuf Receive buffer (significant at destination)
+  //! \param dest Destination rank
+  //! \param sendbuf Send buffer (significant at source)
+  //! \param source Source rank
+  template<typename T>
+  void send_and_recv_probed(std::vector<T>& recvbuf,
+                            int dest,
+                            std::vector<T>& sendbuf,
+                            int source) const;
+
+  //! Send a 1D xtensor from one rank to another, resizing it at destination.  Unlike
+  //! send_and_recv, the shape is not sent in its own message; the destination finds it
+  //! by probing the data message.
+  //! \param recvbuf Receive buffer (significant at destination)
+  //! \param dest Destination rank
+  //! \param sendbuf Send buffer (significant at source)
+  //! \param source Source rank
+  template<typename T>
+  void send_and_recv_probed(xt::xtensor<T, 1>& recvbuf,
+                            int dest,
+                            xt::xtensor<T, 1>& sendbuf,
+                            int source) const;
+
+  //! Send a 1D xtensor of doubles from one rank to another in compressed form,
+  //! resizing it at destination.  The values are compressed losslessly relative to the
+  //! previous values sent between the same ranks (see compress()), which is effective
+  //! for fields that change little between exchanges.
+  //!
+  //! \param recvbuf Receive buffer (significant at destination)
+  //! \param dest Destination rank
+  //! \param sendbuf Send buffer (significant at source)
+  //! \param source Source rank
+  //! \param reference The values from the previous exchange between source and dest,
+  //!        or empty.  Must be the same at source and destination, and is set to the
+  //!        values sent.
+  void send_and_recv_compressed(xt::xtensor<double, 1>& recvbuf,
+                                int dest,
+                                const xt::xtensor<double, 1>& sendbuf,
+                                int source,
+                                std::vector<double>& reference) const
+  {
+    if (!this->active()) {
+      return;
+    }
+    if (dest == source) {
+      if (rank == source) {
+        recvbuf = sendbuf;
+        reference.assign(sendbuf.cbegin(), sendbuf.cend());
+      }
+    } else if (rank == source) {
+      auto bytes = compress(sendbuf.data(), sendbuf.size(), reference);
+      std::vector<unsigned char> unused;
+      send_and_recv_probed(unused, dest, bytes, source);
+      reference.assign(sendbuf.cbegin(), sendbuf.cend());
+    } else if (rank == dest) {
+      std::vector<unsigned char> bytes;
+      std::vector<unsigned char> unused;
+      send_and_recv_probed(bytes, dest, unused, source);
+      reference = decompress(bytes, reference);
+      recvbuf.resize({reference.size()});
+      std::copy(reference.cbegin(), reference.cend(), recvbuf.begin());
+    }
+  }
+
+  //! Send a 1D xtensor of doubles from one rank to another at a reduced precision,
+  //! resizing it at destination.  The values are converted back to doubles at
+  //! destination.
+  //!
+  //! \param recvbuf Receive buffer (significant at destination)
+  //! \param dest Destination rank
+  //! \param sendbuf Send buffer (significant at source)
+  //! \param source Source rank
+  //! \param precision Precision of the values sent
+  //! \param max_error At source, raised to the largest absolute error of a value sent
+  void send_and_recv_encoded(xt::xtensor<double, 1>& recvbuf,
+                             int dest,
+                             const xt::xtensor<double, 1>& sendbuf,
+                             int source,
+                             Precision precision,
+                             double& max_error) const
+  {
+    if (!this->active()) {
+      return;
+    }
+    if (dest == source) {
+      if (rank == source) {
+        recvbuf = sendbuf;
+      }
+    } else if (rank == source) {
+      double error;
+      auto bytes = encode(sendbuf.data(), sendbuf.size(), precision, error);
+      max_error = std::max(max_error, error);
+      std::vector<unsigned char> unused;
+      send_and_recv_probed(unused, dest, bytes, source);
+    } else if (rank == dest) {
+      std::vector<unsigned char> bytes;
+      std::vector<unsigned char> unused;
+      send_and_recv_probed(bytes, dest, unused, source);
+      auto values = decode(bytes);
+      recvbuf.resize({values.size()});
+      std::copy(values.cbegin(), values.cend(), recvbuf.begin());
+    }
+  }
+
+  //! Start sending values from one rank to another without blocking.  Unlike
+  //! send_and_recv, no size is sent, so the receive buffer must already hold count
+  //! values at the destination.
+  //!
+  //! \param recvbuf Receive buffer (significant at destination)
+  //! \param dest Destination rank
+  //! \param sendbuf Send buffer (significant at source)
+  //! \param source Source rank
+  //! \param count Number of values to send
+  //! \return A request to complete with MPI_Wait, or MPI_REQUEST_NULL if there is
+  //!         nothing to wait for (calling rank is neither source nor dest, or dest ==
+  //!         source and the values have been copied)
+  template<typename T>
+  MPI_Request isend_and_recv(T* recvbuf,
+                             int dest,
+                             const T* sendbuf,
+                             int source,
+                             std::size_t count) const;
+
+  //! Start sending a vector from one rank to another without blocking.  The receive
+  //! buffer must already have the size of the send buffer at the destination.
+  //! \return A request to complete with MPI_Wait, or MPI_REQUEST_NULL
+  template<typename T>
+  MPI_Request isend_and_recv(std::vector<T>& recvbuf,
+                             int dest,
+                             const std::vector<T>& sendbuf,
+                             int source) const;
+
+  //! Start sending an xtensor from one rank to another without blocking.  The receive
+  //! buffer must already have the shape of the send buffer at the destination.
+  //! \return A request to complete with MPI_Wait, or MPI_REQUEST_NULL
+  template<typename T, size_t N>
+  MPI_Request isend_and_recv(xt::xtensor<T, N>& recvbuf,
+                             int dest,
+                             const xt::xtensor<T, N>& sendbuf,
+                             int source) const;
+
+  //! Start broadcasting a vector without blocking.  Unlike broadcast, no size is sent,
+  //! so the vector must already have the root's size on every rank.
+  //! \param values Values to broadcast (significant at root)
+  //! \return A request to complete with MPI_Wait, or MPI_REQUEST_NULL
+  template<typename T>
+  MPI_Request ibroadcast(std::vector<T>& values, int root = 0) const;
+
+  //! Start broadcasting an xtensor without blocking.  The xtensor must already have the
+  //! root's shape on every rank.
+  //! \param values Values to broadcast (significant at root)
+  //! \return A request to complete with MPI_Wait, or MPI_REQUEST_NULL
+  template<typename T, size_t N>
+  MPI_Request ibroadcast(xt::xtensor<T, N>& values, int root = 0) const;
+
+  //! Create a persistent request for sending values from one rank to another, for
+  //! exchanges that are repeated with the same buffers and count.  The buffers must
+  //! not move or be resized while the request exists.
+  //!
+  //! \param recvbuf Receive buffer (significant at destination)
+  //! \param dest Destination rank
+  //! \param sendbuf Send buffer (significant at source)
+  //! \param source Source rank
+  //! \param count Number of values to send
+  //! \return An inactive persistent request at source and destination, to be started
+  //!         with MPI_Start (e.g., through PersistentRequests).  MPI_REQUEST_NULL on
+  //!         other ranks, and also when dest == source, in which case the caller
+  //!         copies the values itself.
+  template<typename T>
+  MPI_Request send_and_recv_init(T* recvbuf,
+                                 int dest,
+                                 const T* sendbuf,
+                                 int source,
+                                 std::size_t count) const;
+
+  //! Create a persistent request for sending a vector from one rank to another.  The
+  //! receive buffer must already have the size of the send buffer at the destination.
+  //! \return An inactive persistent request, or MPI_REQUEST_NULL
+  template<typename T>
+  MPI_Request send_and_recv_init(std::vector<T>& recvbuf,
+                                 int dest,
+                                 const std::vector<T>& sendbuf,
+                                 int source) const;
+
+  //! Create a persistent request for sending an xtensor from one rank to another.  The
+  //! receive buffer must already have the shape of the send buffer at the destination.
+  //! \return An inactive persistent request, or MPI_REQUEST_NULL
+  template<typename T, size_t N>
+  MPI_Request send_and_recv_init(xt::xtensor<T, N>& recvbuf,
+                                 int dest,
+                                 const xt::xtensor<T, N>& sendbuf,
+                                 int source) const;
+
+  //! Combine a scalar from all ranks onto a root, in place
+  //! \param value Value contributed by the calling rank, and result at root
+  //! \param op Reduction operation, e.g. MPI_SUM
+  //! \param root Rank of root
+  template<typename T>
+  std::enable_if_t<std::is_scalar<std::decay_t<T>>::value>
+  reduce(T& value, MPI_Op op, int root = 0) const;
+
+  //! Elementwise combine a vector, which has the same size on all ranks, onto a root,
+  //! in place
+  //! \param values Values contributed by the calling rank, and result at root
+  //! \param op Reduction operation, e.g. MPI_SUM
+  //! \param root Rank of root
+  template<typename T>
+  void reduce(std::vector<T>& values, MPI_Op op, int root = 0) const;
+
+  //! Elementwise combine an xtensor, which has the same shape on all ranks, onto a
+  //! root, in place
+  //! \param values Values contributed by the calling rank, and result at root
+  //! \param op Reduction operation, e.g. MPI_SUM
+  //! \param root Rank of root
+  template<typename T, size_t N>
+  void reduce(xt::xtensor<T, N>& values, MPI_Op op, int root = 0) const;
+
+  //! Find the largest or smallest of each value over all ranks, with the rank it came
+  //! from, onto a root, in place.  Ties go to the lowest rank.
+  //! \param values Values contributed by the calling rank, which has the same number on
+  //!   all ranks.  Their ranks are set to the calling rank.  At root, the extremes and
+  //!   the ranks they came from.
+  //! \param op MPI_MAXLOC or MPI_MINLOC
+  //! \param root Rank of root
+  void reduce_loc(std::vector<ValueRank>& values, MPI_Op op, int root = 0) const;
+
+  //! Combine a scalar from all ranks onto all ranks, in place
+  //! \param value Value contributed by the calling rank, and result
+  //! \param op Reduction operation, e.g. MPI_SUM
+  template<typename T>
+  std::enable_if_t<std::is_scalar<std::decay_t<T>>::value>
+  allreduce(T& value, MPI_Op op) const;
+
+  //! Elementwise combine a vector, which has the same size on all ranks, onto all
+  //! ranks, in place
+  template<typename T>
+  void allreduce(std::vector<T>& values, MPI_Op op) const;
+
+  //! Elementwise combine an xtensor, which has the same shape on all ranks, onto all
+  //! ranks, in place
+  template<typename T, size_t N>
+  void allreduce(xt::xtensor<T, N>& values, MPI_Op op) const;
+
+  //! Start combining values onto a root without blocking, in place.  The values must
+  //! not be read or written until the request is complete.
+  //! \param data Values contributed by the calling rank, and result at root
+  //! \param count Number of values
+  //! \param op Reduction operation, e.g. MPI_SUM
+  //! \param root Rank of root
+  //! \return A request to complete with MPI_Wait, or MPI_REQUEST_NULL
+  template<typename T>
+  MPI_Request ireduce(T* data, std::size_t count, MPI_Op op, int root = 0) const;
+
+  //! Start combining values onto all ranks without blocking, in place.  The values must
+  //! not be read or written until the request is complete.
+  //! \param data Values contributed by the calling rank, and result
+  //! \param count Number of values
+  //! \param op Reduction operation, e.g. MPI_SUM
+  //! \return A request to complete with MPI_Wait, or MPI_REQUEST_NULL
+  template<typename T>
+  MPI_Request iallreduce(T* data, std::size_t count, MPI_Op op) const;
+
+  //! Gather vectors of any size from all ranks onto a root, in rank order
+  //! \param sendbuf Values contributed by the calling rank
+  //! \param recvbuf All values, resized at root (significant at root)
+  //! \param counts Number of values from each rank, resized at root (significant at
+  //!        root)
+  //! \param root Rank of root
+  template<typename T>
+  void gatherv(const std::vector<T>& sendbuf,
+               std::vector<T>& recvbuf,
+               std::vector<int>& counts,
+               int root = 0) const;
+
+  //! Gather 1D xtensors of any size from all ranks onto a root, in rank order
+  template<typename T>
+  void gatherv(const xt::xtensor<T, 1>& sendbuf,
+               xt::xtensor<T, 1>& recvbuf,
+               std::vector<int>& counts,
+               int root = 0) const;
+
+  //! Scatter consecutive pieces of a vector from a root to all ranks
+  //! \param sendbuf All values (significant at root)
+  //! \param counts Number of values for each rank (significant at root)
+  //! \param recvbuf Values for the calling rank, resized
+  //! \param root Rank of root
+  template<typename T>
+  void scatterv(const std::vector<T>& sendbuf,
+                const std::vector<int>& counts,
+                std::vector<T>& recvbuf,
+                int root = 0) const;
+
+  //! Scatter consecutive pieces of a 1D xtensor from a root to all ranks
+  template<typename T>
+  void scatterv(const xt::xtensor<T, 1>& sendbuf,
+                const std::vector<int>& counts,
+                xt::xtensor<T, 1>& recvbuf,
+                int root = 0) const;
+
+  //! Send consecutive pieces of a vector from every rank to every rank
+  //! \param sendbuf Values to send, in order of destination rank
+  //! \param sendcounts Number of values for each rank
+  //! \param recvbuf Values received, in order of source rank, resized
+  //! \param recvcounts Number of values from each rank, resized
+  template<typename T>
+  void alltoallv(const std::vector<T>& sendbuf,
+                 const std::vector<int>& sendcounts,
+                 std::vector<T>& recvbuf,
+                 std::vector<int>& recvcounts) const;
+
   //! Gathers together values from the processes in this comm onto a given root.
   //!
   //! Currently, a wrapper for MPI_Gather.
@@ -173,6 +533,11 @@ public:
       sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
   }
 
+  //! Gathers the union of the names held by each rank onto all ranks
+  //! \param names The names held by the calling rank
+  //! \return The names held by any rank, sorted
+  std::vector<std::string> union_names(const std::set<std::string>& names) const;
+
   //! Displays a message from rank 0
   //! \param A message to display
   void message(const std::string& msg, int rank = 0) const
@@ -189,13 +554,81 @@ public:
   int rank = MPI_PROC_NULL;         //!< The calling process's rank in Comm:comm
 };
 
+//! A set of persistent requests (e.g. from Comm::send_and_recv_init) that are started
+//! and completed together.  The requests are freed when the set is destroyed.
+class PersistentRequests {
+public:
+  PersistentRequests() = default;
+  ~PersistentRequests() { free(); }
+
+  PersistentRequests(const PersistentRequests&) = delete;
+  PersistentRequests& operator=(const PersistentRequests&) = delete;
+
+  PersistentRequests(PersistentRequests&& other) noexcept
+  {
+    std::swap(requests_, other.requests_);
+  }
+
+  PersistentRequests& operator=(PersistentRequests&& other) noexcept
+  {
+    std::swap(requests_, other.requests_);
+    return *this;
+  }
+
+  //! Adds an inactive persistent request to the set.  MPI_REQUEST_NULL is ignored.
+  void add(MPI_Request request)
+  {
+    if (request != MPI_REQUEST_NULL) {
+      requests_.push_back(request);
+    }
+  }
+
+  //! Starts all requests in the set
+  void start()
+  {
+    auto counted = comm_counters.count("persistent_start");
+    if (!requests_.empty()) {
+      if (comm_counters.enabled()) {
+        for (auto r : requests_) {
+          comm_counters.sent_persistent(counted, r);
+        }
+      }
+      MPI_Startall(requests_.size(), requests_.data());
+    }
+  }
+
+  //! Blocks until all started requests in the set are complete
+  void wait()
+  {
+    auto counted = comm_counters.count("persistent_wait");
+    if (!requests_.empty()) {
+      MPI_Waitall(requests_.size(), requests_.data(), MPI_STATUSES_IGNORE);
+    }
+  }
+
+  //! Frees all requests in the set.  They must not be active.
+  void free()
+  {
+    for (auto& r : requests_) {
+      comm_counters.remove_persistent(r);
+      MPI_Request_free(&r);
+    }
+    requests_.clear();
+  }
+
+private:
+  std::vector<MPI_Request> requests_; //!< Inactive or active persistent requests
+};
+
 template<typename T>
 std::enable_if_t<std::is_scalar<std::decay_t<T>>::value>
 Comm::send_and_recv(T& value, int dest, int source) const
 {
+  auto counted = comm_counters.count("send_and_recv");
   if (this->active() && dest != source) {
     int tag = source;
     if (rank == source) {
+      counted.sent(sizeof(T));
       MPI_Send(&value, 1, get_mpi_type<T>(), dest, tag, comm);
     } else if (rank == dest) {
       MPI_Recv(&value, 1, get_mpi_type<T>(), source, tag, comm, MPI_STATUS_IGNORE);
@@ -206,6 +639,7 @@ Comm::send_and_recv(T& value, int dest, int source) const
 template<typename T>
 void Comm::send_and_recv(std::vector<T>& values, int dest, int source) const
 {
+  auto counted = comm_counters.count("send_and_recv");
   if (this->active() && dest != source) {
     // Send the size of the vector from the source
     auto n = values.size();
@@ -218,6 +652,7 @@ void Comm::send_and_recv(std::vector<T>& values, int dest, int source) const
     // Send the vector
     int tag = source;
     if (rank == source) {
+      counted.sent(n * sizeof(T));
       MPI_Send(values.data(), n, get_mpi_type<T>(), dest, tag, comm);
     } else if (rank == dest) {
       MPI_Recv(values.data(), n, get_mpi_type<T>(), source, tag, comm, MPI_STATUS_IGNORE);
@@ -228,6 +663,7 @@ void Comm::send_and_recv(std::vector<T>& values, int dest, int source) const
 template<typename T, size_t N>
 void Comm::send_and_recv(xt::xtensor<T, N>& values, int dest, int source) const
 {
+  auto counted = comm_counters.count("send_and_recv");
   if (this->active() && dest != source) {
     // Make sure the shapes match
     const auto& s = values.shape();
@@ -241,6 +677,7 @@ void Comm::send_and_recv(xt::xtensor<T, N>& values, int dest, int source) const
     // Finally, send data
     int tag = source;
     if (rank == source) {
+      counted.sent(values.size() * sizeof(T));
       MPI_Send(values.data(), values.size(), get_mpi_type<T>(), dest, tag, comm);
     } else if (rank == dest) {
       MPI_Recv(values.data(),
@@ -258,10 +695,12 @@ template<typename T>
 std::enable_if_t<std::is_scalar<std::decay_t<T>>::value>
 Comm::send_and_recv(T& recvbuf, int dest, T& sendbuf, int source) const
 {
+  auto counted = comm_counters.count("send_and_recv");
   if (this->active()) {
     if (dest != source) {
       int tag = source;
       if (rank == source) {
+        counted.sent(sizeof(T));
         MPI_Send(&sendbuf, 1, get_mpi_type<T>(), dest, tag, comm);
       } else if (rank == dest) {
         MPI_Recv(&recvbuf, 1, get_mpi_type<T>(), source, tag, comm, MPI_STATUS_IGNORE);
@@ -278,6 +717,7 @@ void Comm::send_and_recv(std::vector<T>& recvbuf,
                          std::vector<T>& sendbuf,
                          int source) const
 {
+  auto counted = comm_counters.count("send_and_recv");
   if (this->active()) {
     if (dest != source) {
       // Send the size of the vector from the source
@@ -291,6 +731,7 @@ void Comm::send_and_recv(std::vector<T>& recvbuf,
       // Send the vector
       int tag = source;
       if (rank == source) {
+        counted.sent(n * sizeof(T));
         MPI_Send(sendbuf.data(), n, get_mpi_type<T>(), dest, tag, comm);
       } else if (rank == dest) {
         MPI_Recv(
@@ -309,6 +750,7 @@ void Comm::send_and_recv(xt::xtensor<T, N>& recvbuf,
                          xt::xtensor<T, N>& sendbuf,
                          int source) const
 {
+  auto counted = comm_counters.count("send_and_recv");
   if (this->active()) {
     if (dest != source) {
       // Make sure the shapes match
@@ -324,6 +766,7 @@ void Comm::send_and_recv(xt::xtensor<T, N>& recvbuf,
       // Finally, send data
       int tag = source;
       if (rank == source) {
+        counted.sent(sendbuf.size() * sizeof(T));
         MPI_Send(sendbuf.data(), sendbuf.size(), get_mpi_type<T>(), dest, tag, comm);
       } else if (rank == dest) {
         MPI_Recv(recvbuf.data(),
@@ -341,11 +784,487 @@ void Comm::send_and_recv(xt::xtensor<T, N>& recvbuf,
   }
 }
 
+template<typename T>
+void Comm::send_and_recv(std::vector<T>& recvbuf,
+                         int dest,
+                         std::vector<T>& sendbuf,
+                         int source,
+                         std::size_t count) const
+{
+  auto counted = comm_counters.count("send_and_recv");
+  if (rank == dest) {
+    recvbuf.resize(count);
+  }
+  auto request = isend_and_recv(recvbuf, dest, sendbuf, source);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+
+template<typename T, size_t N>
+void Comm::send_and_recv(xt::xtensor<T, N>& recvbuf,
+                         int dest,
+                         xt::xtensor<T, N>& sendbuf,
+                         int source,
+                         const std::array<std::size_t, N>& shape) const
+{
+  auto counted = comm_counters.count("send_and_recv");
+  if (rank == dest) {
+    recvbuf.resize(shape);
+  }
+  auto request = isend_and_recv(recvbuf, dest, sendbuf, source);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+
+template<typename T>
+void Comm::send_and_recv_probed(std::vector<T>& recvbuf,
+                                int dest,
+                                std::vector<T>& sendbuf,
+                                int source) const
+{
+  auto counted = comm_counters.count("send_and_recv_probed");
+  if (this->active()) {
+    if (dest != source) {
+      int tag = source;
+      if (rank == source) {
+        counted.sent(sendbuf.size() * sizeof(T));
+        MPI_Send(sendbuf.data(), sendbuf.size(), get_mpi_type<T>(), dest, tag, comm);
+      } else if (rank == dest) {
+        MPI_Status status;
+        int n;
+        MPI_Probe(source, tag, comm, &status);
+        MPI_Get_count(&status, get_mpi_type<T>(), &n);
+        recvbuf.resize(n);
+        MPI_Recv(
+          recvbuf.data(), n, get_mpi_type<T>(), source, tag, comm, MPI_STATUS_IGNORE);
+      }
+    } else { // dest == source
+      recvbuf.resize(sendbuf.size());
+      std::copy(sendbuf.cbegin(), sendbuf.cend(), recvbuf.begin());
+    }
+  }
+}
+
+template<typename T>
+void Comm::send_and_recv_probed(xt::xtensor<T, 1>& recvbuf,
+                                int dest,
+                                xt::xtensor<T, 1>& sendbuf,
+                                int source) const
+{
+  auto counted = comm_counters.count("send_and_recv_probed");
+  if (this->active()) {
+    if (dest != source) {
+      int tag = source;
+      if (rank == source) {
+        counted.sent(sendbuf.size() * sizeof(T));
+        MPI_Send(sendbuf.data(), sendbuf.size(), get_mpi_type<T>(), dest, tag, comm);
+      } else if (rank == dest) {
+        MPI_Status status;
+        int n;
+        MPI_Probe(source, tag, comm, &status);
+        MPI_Get_count(&status, get_mpi_type<T>(), &n);
+        recvbuf.resize({static_cast<std::size_t>(n)});
+        MPI_Recv(
+          recvbuf.data(), n, get_mpi_type<T>(), source, tag, comm, MPI_STATUS_IGNORE);
+      }
+    } else { // dest == source
+      recvbuf.resize(sendbuf.shape());
+      std::copy(sendbuf.cbegin(), sendbuf.cend(), recvbuf.begin());
+    }
+  }
+}
+
+template<typename T>
+MPI_Request Comm::isend_and_recv(T* recvbuf,
+                                 int dest,
+                                 const T* sendbuf,
+                                 int source,
+                                 std::size_t count) const
+{
+  auto counted = comm_counters.count("isend_and_recv");
+  MPI_Request request = MPI_REQUEST_NULL;
+  if (this->active()) {
+    if (dest != source) {
+      int tag = source;
+      if (rank == source) {
+        counted.sent(count * sizeof(T));
+        MPI_Isend(sendbuf, count, get_mpi_type<T>(), dest, tag, comm, &request);
+      } else if (rank == dest) {
+        MPI_Irecv(recvbuf, count, get_mpi_type<T>(), source, tag, comm, &request);
+      }
+    } else if (rank == source) {
+      std::copy_n(sendbuf, count, recvbuf);
+    }
+  }
+  return request;
+}
+
+template<typename T>
+MPI_Request Comm::isend_and_recv(std::vector<T>& recvbuf,
+                                 int dest,
+                                 const std::vector<T>& sendbuf,
+                                 int source) const
+{
+  auto counted = comm_counters.count("isend_and_recv");
+  auto n = rank == source ? sendbuf.size() : recvbuf.size();
+  if (rank == source && dest == source) {
+    recvbuf.resize(n);
+  }
+  return isend_and_recv(recvbuf.data(), dest, sendbuf.data(), source, n);
+}
+
+template<typename T, size_t N>
+MPI_Request Comm::isend_and_recv(xt::xtensor<T, N>& recvbuf,
+                                 int dest,
+                                 const xt::xtensor<T, N>& sendbuf,
+                                 int source) const
+{
+  auto counted = comm_counters.count("isend_and_recv");
+  auto n = rank == source ? sendbuf.size() : recvbuf.size();
+  if (rank == source && dest == source) {
+    recvbuf.resize(sendbuf.shape());
+  }
+  return isend_and_recv(recvbuf.data(), dest, sendbuf.data(), source, n);
+}
+
+template<typename T>
+MPI_Request Comm::ibroadcast(std::vector<T>& values, int root) const
+{
+  auto counted = comm_counters.count("ibroadcast");
+  MPI_Request request = MPI_REQUEST_NULL;
+  if (this->active()) {
+    if (rank == root) {
+      counted.sent(values.size() * sizeof(T));
+    }
+    MPI_Ibcast(values.data(), values.size(), get_mpi_type<T>(), root, comm, &request);
+  }
+  return request;
+}
+
+template<typename T, size_t N>
+MPI_Request Comm::ibroadcast(xt::xtensor<T, N>& values, int root) const
+{
+  auto counted = comm_counters.count("ibroadcast");
+  MPI_Request request = MPI_REQUEST_NULL;
+  if (this->active()) {
+    if (rank == root) {
+      counted.sent(values.size() * sizeof(T));
+    }
+    MPI_Ibcast(values.data(), values.size(), get_mpi_type<T>(), root, comm, &request);
+  }
+  return request;
+}
+
+template<typename T>
+MPI_Request Comm::send_and_recv_init(T* recvbuf,
+                                     int dest,
+                                     const T* sendbuf,
+                                     int source,
+                                     std::size_t count) const
+{
+  auto counted = comm_counters.count("send_and_recv_init");
+  MPI_Request request = MPI_REQUEST_NULL;
+  if (this->active() && dest != source) {
+    int tag = source;
+    if (rank == source) {
+      MPI_Send_init(sendbuf, count, get_mpi_type<T>(), dest, tag, comm, &request);
+      comm_counters.add_persistent(request, count * sizeof(T));
+    } else if (rank == dest) {
+      MPI_Recv_init(recvbuf, count, get_mpi_type<T>(), source, tag, comm, &request);
+    }
+  }
+  return request;
+}
+
+template<typename T>
+MPI_Request Comm::send_and_recv_init(std::vector<T>& recvbuf,
+                                     int dest,
+                                     const std::vector<T>& sendbuf,
+                                     int source) const
+{
+  auto counted = comm_counters.count("send_and_recv_init");
+  auto n = rank == source ? sendbuf.size() : recvbuf.size();
+  return send_and_recv_init(recvbuf.data(), dest, sendbuf.data(), source, n);
+}
+
+template<typename T, size_t N>
+MPI_Request Comm::send_and_recv_init(xt::xtensor<T, N>& recvbuf,
+                                     int dest,
+                                     const xt::xtensor<T, N>& sendbuf,
+                                     int source) const
+{
+  auto counted = comm_counters.count("send_and_recv_init");
+  auto n = rank == source ? sendbuf.size() : recvbuf.size();
+  return send_and_recv_init(recvbuf.data(), dest, sendbuf.data(), source, n);
+}
+
+template<typename T>
+std::enable_if_t<std::is_scalar<std::decay_t<T>>::value>
+Comm::reduce(T& value, MPI_Op op, int root) const
+{
+  auto counted = comm_counters.count("reduce");
+  if (this->active()) {
+    counted.sent(sizeof(T));
+    if (rank == root) {
+      MPI_Reduce(MPI_IN_PLACE, &value, 1, get_mpi_type<T>(), op, root, comm);
+    } else {
+      MPI_Reduce(&value, nullptr, 1, get_mpi_type<T>(), op, root, comm);
+    }
+  }
+}
+
+template<typename T>
+void Comm::reduce(std::vector<T>& values, MPI_Op op, int root) const
+{
+  auto counted = comm_counters.count("reduce");
+  if (this->active()) {
+    auto request = ireduce(values.data(), values.size(), op, root);
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+  }
+}
+
+template<typename T, size_t N>
+void Comm::reduce(xt::xtensor<T, N>& values, MPI_Op op, int root) const
+{
+  auto counted = comm_counters.count("reduce");
+  if (this->active()) {
+    auto request = ireduce(values.data(), values.size(), op, root);
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+  }
+}
+
+template<typename T>
+std::enable_if_t<std::is_scalar<std::decay_t<T>>::value>
+Comm::allreduce(T& value, MPI_Op op) const
+{
+  auto counted = comm_counters.count("allreduce");
+  if (this->active()) {
+    counted.sent(sizeof(T));
+    MPI_Allreduce(MPI_IN_PLACE, &value, 1, get_mpi_type<T>(), op, comm);
+  }
+}
+
+template<typename T>
+void Comm::allreduce(std::vector<T>& values, MPI_Op op) const
+{
+  auto counted = comm_counters.count("allreduce");
+  if (this->active()) {
+    counted.sent(values.size() * sizeof(T));
+    MPI_Allreduce(
+      MPI_IN_PLACE, values.data(), values.size(), get_mpi_type<T>(), op, comm);
+  }
+}
+
+template<typename T, size_t N>
+void Comm::allreduce(xt::xtensor<T, N>& values, MPI_Op op) const
+{
+  auto counted = comm_counters.count("allreduce");
+  if (this->active()) {
+    counted.sent(values.size() * sizeof(T));
+    MPI_Allreduce(
+      MPI_IN_PLACE, values.data(), values.size(), get_mpi_type<T>(), op, comm);
+  }
+}
+
+template<typename T>
+MPI_Request Comm::ireduce(T* data, std::size_t count, MPI_Op op, int root) const
+{
+  auto counted = comm_counters.count("ireduce");
+  MPI_Request request = MPI_REQUEST_NULL;
+  if (this->active()) {
+    counted.sent(count * sizeof(T));
+    if (rank == root) {
+      MPI_Ireduce(
+        MPI_IN_PLACE, data, count, get_mpi_type<T>(), op, root, comm, &request);
+    } else {
+      MPI_Ireduce(data, nullptr, count, get_mpi_type<T>(), op, root, comm, &request);
+    }
+  }
+  return request;
+}
+
+template<typename T>
+MPI_Request Comm::iallreduce(T* data, std::size_t count, MPI_Op op) const
+{
+  auto counted = comm_counters.count("iallreduce");
+  MPI_Request request = MPI_REQUEST_NULL;
+  if (this->active()) {
+    counted.sent(count * sizeof(T));
+    MPI_Iallreduce(MPI_IN_PLACE, data, count, get_mpi_type<T>(), op, comm, &request);
+  }
+  return request;
+}
+
+template<typename T>
+void Comm::gatherv(const std::vector<T>& sendbuf,
+                   std::vector<T>& recvbuf,
+                   std::vector<int>& counts,
+                   int root) const
+{
+  auto counted = comm_counters.count("gatherv");
+  if (this->active()) {
+    int n = sendbuf.size();
+    std::vector<int> displs;
+    if (rank == root) {
+      counts.resize(size);
+      displs.resize(size);
+    }
+    counted.sent(n * sizeof(T));
+    Gather(&n, 1, MPI_INT, counts.data(), 1, MPI_INT, root);
+    if (rank == root) {
+      for (int i = 1; i < size; ++i) {
+        displs[i] = displs[i - 1] + counts[i - 1];
+      }
+      recvbuf.resize(displs.back() + counts.back());
+    }
+    MPI_Gatherv(sendbuf.data(),
+                n,
+                get_mpi_type<T>(),
+                recvbuf.data(),
+                counts.data(),
+                displs.data(),
+                get_mpi_type<T>(),
+                root,
+                comm);
+  }
+}
+
+template<typename T>
+void Comm::gatherv(const xt::xtensor<T, 1>& sendbuf,
+                   xt::xtensor<T, 1>& recvbuf,
+                   std::vector<int>& counts,
+                   int root) const
+{
+  auto counted = comm_counters.count("gatherv");
+  if (this->active()) {
+    int n = sendbuf.size();
+    std::vector<int> displs;
+    if (rank == root) {
+      counts.resize(size);
+      displs.resize(size);
+    }
+    counted.sent(n * sizeof(T));
+    Gather(&n, 1, MPI_INT, counts.data(), 1, MPI_INT, root);
+    if (rank == root) {
+      for (int i = 1; i < size; ++i) {
+        displs[i] = displs[i - 1] + counts[i - 1];
+      }
+      recvbuf.resize({static_cast<std::size_t>(displs.back() + counts.back())});
+    }
+    MPI_Gatherv(sendbuf.data(),
+                n,
+                get_mpi_type<T>(),
+                recvbuf.data(),
+                counts.data(),
+                displs.data(),
+                get_mpi_type<T>(),
+                root,
+                comm);
+  }
+}
+
+template<typename T>
+void Comm::scatterv(const std::vector<T>& sendbuf,
+                    const std::vector<int>& counts,
+                    std::vector<T>& recvbuf,
+                    int root) const
+{
+  auto counted = comm_counters.count("scatterv");
+  if (this->active()) {
+    int n;
+    std::vector<int> displs;
+    if (rank == root) {
+      displs.resize(size);
+      for (int i = 1; i < size; ++i) {
+        displs[i] = displs[i - 1] + counts[i - 1];
+      }
+      counted.sent((displs.back() + counts.back()) * sizeof(T));
+    }
+    MPI_Scatter(counts.data(), 1, MPI_INT, &n, 1, MPI_INT, root, comm);
+    recvbuf.resize(n);
+    MPI_Scatterv(sendbuf.data(),
+                 counts.data(),
+                 displs.data(),
+                 get_mpi_type<T>(),
+                 recvbuf.data(),
+                 n,
+                 get_mpi_type<T>(),
+                 root,
+                 comm);
+  }
+}
+
+template<typename T>
+void Comm::scatterv(const xt::xtensor<T, 1>& sendbuf,
+                    const std::vector<int>& counts,
+                    xt::xtensor<T, 1>& recvbuf,
+                    int root) const
+{
+  auto counted = comm_counters.count("scatterv");
+  if (this->active()) {
+    int n;
+    std::vector<int> displs;
+    if (rank == root) {
+      displs.resize(size);
+      for (int i = 1; i < size; ++i) {
+        displs[i] = displs[i - 1] + counts[i - 1];
+      }
+      counted.sent((displs.back() + counts.back()) * sizeof(T));
+    }
+    MPI_Scatter(counts.data(), 1, MPI_INT, &n, 1, MPI_INT, root, comm);
+    recvbuf.resize({static_cast<std::size_t>(n)});
+    MPI_Scatterv(sendbuf.data(),
+                 counts.data(),
+                 displs.data(),
+                 get_mpi_type<T>(),
+                 recvbuf.data(),
+                 n,
+                 get_mpi_type<T>(),
+                 root,
+                 comm);
+  }
+}
+
+template<typename T>
+void Comm::alltoallv(const std::vector<T>& sendbuf,
+                     const std::vector<int>& sendcounts,
+                     std::vector<T>& recvbuf,
+                     std::vector<int>& recvcounts) const
+{
+  auto counted = comm_counters.count("alltoallv");
+  if (this->active()) {
+    counted.sent(
+      std::accumulate(sendcounts.cbegin(), sendcounts.cend(), std::size_t{0}) *
+      sizeof(T));
+    recvcounts.resize(size);
+    MPI_Alltoall(sendcounts.data(), 1, MPI_INT, recvcounts.data(), 1, MPI_INT, comm);
+
+    std::vector<int> sdispls(size, 0);
+    std::vector<int> rdispls(size, 0);
+    for (int i = 1; i < size; ++i) {
+      sdispls[i] = sdispls[i - 1] + sendcounts[i - 1];
+      rdispls[i] = rdispls[i - 1] + recvcounts[i - 1];
+    }
+    recvbuf.resize(rdispls.back() + recvcounts.back());
+    MPI_Alltoallv(sendbuf.data(),
+                  sendcounts.data(),
+                  sdispls.data(),
+                  get_mpi_type<T>(),
+                  recvbuf.data(),
+                  recvcounts.data(),
+                  rdispls.data(),
+                  get_mpi_type<T>(),
+                  comm);
+  }
+}
+
 template<typename T>
 std::enable_if_t<std::is_scalar<std::decay_t<T>>::value> Comm::broadcast(T& value,
                                                                          int root) const
 {
+  auto counted = comm_counters.count("broadcast");
   if (this->active()) {
+    if (rank == root) {
+      counted.sent(sizeof(T));
+    }
     Bcast(&value, 1, get_mpi_type<T>(), root);
   }
 }
@@ -353,6 +1272,7 @@ std::enable_if_t<std::is_scalar<std::decay_t<T>>::value> Comm::broadcast(T& valu
 template<typename T>
 void Comm::broadcast(std::vector<T>& values, int root) const
 {
+  auto counted = comm_counters.count("broadcast");
   if (this->active()) {
     // First broadcast the size of the vector
     int n = values.size();
@@ -361,6 +1281,9 @@ void Comm::broadcast(std::vector<T>& values, int root) const
     // Resize vector (for rank != 0) and broacast data
     if (values.size() != n)
       values.resize(n);
+    if (rank == root) {
+      counted.sent(n * sizeof(T));
+    }
     Bcast(values.data(), n, get_mpi_type<T>(), root);
   }
 }
@@ -368,6 +1291,7 @@ void Comm::broadcast(std::vector<T>& values, int root) const
 template<typename T, size_t N>
 void Comm::broadcast(xt::xtensor<T, N>& values, int root) const
 {
+  auto counted = comm_counters.count("broadcast");
   if (this->active()) {
     // First, make sure shape of `values` matches root's
     const auto& s = values.shape();
@@ -383,10 +1307,61 @@ void Comm::broadcast(xt::xtensor<T, N>& values, int root) const
     auto n = values.size();
 
     // Finally, broadcast data
+    if (rank == root) {
+      counted.sent(n * sizeof(T));
+    }
     Bcast(values.data(), n, get_mpi_type<T>(), root);
   }
 }
 
+inline void Comm::reduce_loc(std::vector<ValueRank>& values, MPI_Op op, int root) const
+{
+  auto counted = comm_counters.count("reduce_loc");
+  if (this->active()) {
+    for (auto& v : values) {
+      v.rank = rank;
+    }
+    counted.sent(values.size() * sizeof(ValueRank));
+    const void* sendbuf = rank == root ? MPI_IN_PLACE : values.data();
+    MPI_Reduce(sendbuf, values.data(), values.size(), MPI_DOUBLE_INT, op, root, comm);
+  }
+}
+
+inline std::vector<std::string> Comm::union_names(
+  const std::set<std::string>& names) const
+{
+  if (!this->active()) {
+    return {names.begin(), names.end()};
+  }
+
+  // Names are sent as lines of text
+  auto join = [](const std::set<std::string>& names) {
+    std::vector<char> text;
+    for (const auto& name : names) {
+      text.insert(text.end(), name.begin(), name.end());
+      text.push_back('\n');
+    }
+    return text;
+  };
+  auto split = [](const std::vector<char>& text) {
+    std::set<std::string> names;
+    std::istringstream is{std::string{text.begin(), text.end()}};
+    std::string name;
+    while (std::getline(is, name)) {
+      names.insert(name);
+    }
+    return names;
+  };
+
+  std::vector<char> all;
+  std::vector<int> counts;
+  gatherv(join(names), all, counts);
+  auto text = is_root() ? join(split(all)) : std::vector<char>{};
+  broadcast(text);
+  auto result = split(text);
+  return {result.begin(), result.end()};
+}
+
 } // namespace enrico
 
 #endif // ENRICO_COMM_H
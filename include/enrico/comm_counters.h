@@ -0,0 +1,167 @@
+//! \file comm_counters.h
+//! Counters of the messages, bytes, and time of communication through Comm
+#ifndef ENRICO_COMM_COUNTERS_H
+#define ENRICO_COMM_COUNTERS_H
+
+#include <mpi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility> // for pair
+
+namespace enrico {
+
+class Comm;
+
+//! Counters of the communication operations of Comm, kept per operation and per call
+//! site.  The call site of an operation is the innermost timer region open on the
+//! calling thread (see TimerRegistry), e.g. "CoupledDriver/update_temperature".
+//!
+//! Counting is off until enabled, so that uninstrumented runs only pay for one check
+//! per operation.  Messages and bytes are counted on the rank that sends them, and time
+//! is counted on every rank that takes part, including time spent blocked.
+class CommCounters {
+public:
+  //! Counts of one operation at one call site
+  struct Count {
+    double seconds = 0.0;     //!< Time spent in the operation
+    std::size_t calls = 0;    //!< Number of times the operation was called
+    std::size_t messages = 0; //!< Messages sent
+    std::size_t bytes = 0;    //!< Bytes sent
+  };
+
+  //! An operation being counted, which is finished when destroyed.  Operations used by
+  //! another operation on the same thread are counted as part of it.
+  class Op {
+  public:
+    Op(CommCounters& counters, const char* name)
+    {
+      if (!counters.enabled()) {
+        return;
+      }
+      auto& active = active_op();
+      if (active) {
+        target_ = active;
+      } else {
+        counters_ = &counters;
+        name_ = name;
+        target_ = this;
+        active = this;
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+
+    Op(Op&& other) noexcept
+      : counters_(other.counters_)
+      , name_(other.name_)
+      , target_(other.target_ == &other ? this : other.target_)
+      , start_(other.start_)
+      , bytes_(other.bytes_)
+      , messages_(other.messages_)
+    {
+      if (active_op() == &other) {
+        active_op() = this;
+      }
+      other.counters_ = nullptr;
+      other.target_ = nullptr;
+    }
+
+    ~Op()
+    {
+      if (counters_) {
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start_;
+        counters_->add(name_, seconds.count(), bytes_, messages_);
+        active_op() = nullptr;
+      }
+    }
+
+    Op(const Op&) = delete;
+    Op& operator=(const Op&) = delete;
+    Op& operator=(Op&&) = delete;
+
+    //! Count a message sent by the calling rank
+    //! \param bytes Size of the message
+    void sent(std::size_t bytes)
+    {
+      if (target_) {
+        target_->bytes_ += bytes;
+        ++target_->messages_;
+      }
+    }
+
+  private:
+    //! The outermost operation being counted on the calling thread
+    static Op*& active_op()
+    {
+      thread_local Op* op = nullptr;
+      return op;
+    }
+
+    CommCounters* counters_ = nullptr; //!< Set only for the outermost operation
+    const char* name_ = nullptr;       //!< Name of the operation
+    Op* target_ = nullptr; //!< Operation that messages are counted in, if counting
+    std::chrono::steady_clock::time_point start_; //!< When the operation started
+    std::size_t bytes_ = 0;                       //!< Bytes sent
+    std::size_t messages_ = 0;                    //!< Messages sent
+  };
+
+  //! Start counting an operation
+  //! \param name Name of the operation, which must outlive the counters
+  //! \return The operation, which is counted when destroyed
+  Op count(const char* name) { return Op{*this, name}; }
+
+  //! Turn counting on or off
+  void enable(bool on) { enabled_ = on; }
+
+  //! Queries whether operations are counted
+  bool enabled() const { return enabled_; }
+
+  //! Remember the size of the message sent by a persistent send request, which is
+  //! counted each time the request is started
+  //! \param request An inactive persistent send request
+  //! \param bytes Size of the message
+  void add_persistent(MPI_Request request, std::size_t bytes);
+
+  //! Forget a persistent request before it is freed
+  void remove_persistent(MPI_Request request);
+
+  //! Count the messages sent by a started persistent request, if it is a send
+  //! \param op The operation that started the request
+  //! \param request A persistent request
+  void sent_persistent(Op& op, MPI_Request request) const;
+
+  //! Print the counts of each call site and operation, summed over the ranks of a comm,
+  //! with the largest time over those ranks.  Collective over comm.
+  //! \param comm The comm over which counts are combined
+  void report(const Comm& comm) const;
+
+  //! Reset all counts to 0
+  void reset();
+
+  //! Get the counts of one operation at one call site on the calling rank
+  //! \param site The call site, which is "-" outside of any timer region
+  //! \param name Name of the operation
+  //! \return The counts, which are all 0 if the operation was not counted there
+  Count get(const std::string& site, const std::string& name) const;
+
+private:
+  //! Add a finished operation to the counts of the calling thread's call site
+  void add(const char* name, double seconds, std::size_t bytes, std::size_t messages);
+
+  std::atomic<bool> enabled_{false}; //!< Whether operations are counted
+  mutable std::mutex mutex_;         //!< Guards counts_ and persistent_
+  //! Counts of each call site and operation
+  std::map<std::pair<std::string, std::string>, Count> counts_;
+  std::map<MPI_Request, std::size_t> persistent_; //!< Bytes of persistent sends
+};
+
+//! Communication counters of the calling process, shared by all comms
+extern CommCounters comm_counters;
+
+} // namespace enrico
+
+#endif // ENRICO_COMM_COUNTERS_H
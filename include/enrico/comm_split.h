@@ -5,9 +5,17 @@
 
 #include <array>
 #include <mpi.h>
+#include <vector>
 
 namespace enrico {
 
+//! How the ranks of each driver are chosen within a node
+enum class Placement {
+  block,      //!< The lowest intranode ranks
+  interleave, //!< Ranks dealt out evenly to the NUMA domains (e.g., sockets)
+  numa        //!< Whole NUMA domains, from the first for driver 0 and last for driver 1
+};
+
 //! Splits a given MPI communicator into new communicators for each single-physics driver
 //!
 //! \param[in] super_comm An existing communicator that will be split
@@ -29,6 +37,46 @@ void get_driver_comms(Comm super_comm,
                       Comm& intranode_comm,
                       Comm& coupling_comm);
 
+//! Splits a given MPI communicator into new communicators for each single-physics
+//! driver, choosing the ranks of each driver within a node according to the NUMA
+//! domains of the node
+//!
+//! \param[in] super_comm An existing communicator that will be split
+//! \param[in] num_nodes The desired number of nodes for the each single-physics driver's
+//!            new communicator.  If a value is <= 0, then the respective driver's
+//!            communicator will contain all nodes of super_comm
+//! \param[in] procs_per_node The desired number of procs/node for each single-physics
+//!            driver's new communicator.  If a value is <=, then the respective driver's
+//!            communicator will contain the maximum number of available procs/node
+//! \param[in] placement How the procs/node of each driver are chosen within a node
+//! \param[in] numa_domains The number of NUMA domains per node.  If a value is > 0,
+//!            ranks are assumed to be bound to domains in contiguous blocks of
+//!            intranode ranks.  If <= 0, the domains are queried from the MPI library.
+//!            Not used for Placement::block.
+//! \param[out] driver_comms The newly-created communicators, one for each driver.
+//!             Each is comm active on the calling rank if it's contained by the respective
+//!             driver; and null if not.
+//! \param[out] intranode_comm A new comm that spans the node that the calling rank is in
+//! \param[out] coupling_comm A new comm containing one proc per node.
+void get_driver_comms(Comm super_comm,
+                      std::array<int, 2> num_nodes,
+                      std::array<int, 2> procs_per_node,
+                      Placement placement,
+                      int numa_domains,
+                      std::array<Comm, 2>& driver_comms,
+                      Comm& intranode_comm,
+                      Comm& coupling_comm);
+
+//! Chooses how many nodes each driver gets so that the drivers, which run one after
+//! another in the Picard loop, spend the least total time per iteration.  Assumes each
+//! driver scales perfectly across nodes and that the drivers do not share nodes.
+//!
+//! \param work The node-seconds of each driver's solve, e.g. its solve time times its
+//!        number of nodes in a previous run
+//! \param total_nodes The number of nodes to split between the drivers
+//! \return The number of nodes for each driver, each at least 1
+std::array<int, 2> balance_nodes(std::array<double, 2> work, int total_nodes);
+
 //! Gathers the ranks (wrt super) that are also in sub
 std::vector<int> gather_subcomm_ranks(const Comm& super, const Comm& sub);
 }
@@ -0,0 +1,60 @@
+//! \file compression.h
+//! Compression of double arrays for coupling transfers
+#ifndef ENRICO_COMPRESSION_H
+#define ENRICO_COMPRESSION_H
+
+#include <cstddef>
+#include <vector>
+
+namespace enrico {
+
+//! Losslessly compresses an array of doubles relative to a reference array, e.g. the
+//! previous Picard iterate of the same field.
+//!
+//! Each value's bits are XORed with those of its reference value, so values that
+//! changed little have many leading zero bits.  The bytes are then shuffled so that
+//! bytes of equal significance are contiguous, and runs of zero bytes are
+//! run-length encoded.  If this does not shrink the data, the raw bytes are kept.
+//!
+//! \param values Values to compress
+//! \param n Number of values
+//! \param reference Reference values.  If its size is not n, zeros are used instead.
+//! \return The compressed bytes, which record n
+std::vector<unsigned char>
+compress(const double* values, std::size_t n, const std::vector<double>& reference);
+
+//! Decompresses an array of doubles compressed by compress()
+//!
+//! \param bytes The compressed bytes
+//! \param reference The reference values that were passed to compress()
+//! \return The decompressed values
+std::vector<double> decompress(const std::vector<unsigned char>& bytes,
+                               const std::vector<double>& reference);
+
+//! Precision at which an array of doubles is sent
+enum class Precision {
+  full,   //!< 64-bit floating point, i.e. unchanged
+  single, //!< 32-bit floating point
+  fixed   //!< 16-bit fixed point, scaled to the range of each array
+};
+
+//! Encodes an array of doubles at a reduced precision
+//!
+//! \param values Values to encode
+//! \param n Number of values
+//! \param precision Precision of the encoded values
+//! \param max_error Set to the largest absolute difference between a value and its
+//!        decoded value
+//! \return The encoded bytes, which record n and the precision
+std::vector<unsigned char>
+encode(const double* values, std::size_t n, Precision precision, double& max_error);
+
+//! Decodes an array of doubles encoded by encode()
+//!
+//! \param bytes The encoded bytes
+//! \return The decoded values
+std::vector<double> decode(const std::vector<unsigned char>& bytes);
+
+} // namespace enrico
+
+#endif // ENRICO_COMPRESSION_H
@@ -4,16 +4,23 @@
 #ifndef ENRICO_COUPLED_DRIVER_H
 #define ENRICO_COUPLED_DRIVER_H
 
+#include "enrico/cell_record.h"
+#include "enrico/comm_split.h"
+#include "enrico/compression.h"
 #include "enrico/driver.h"
 #include "enrico/heat_fluids_driver.h"
 #include "enrico/neutronics_driver.h"
+#include "enrico/shared_window.h"
 #include "enrico/timer.h"
 
 #include <pugixml.hpp>
 #include <xtensor/xtensor.hpp>
 
+#include <array>
+#include <deque>
 #include <map>
 #include <memory> // for unique_ptr
+#include <string>
 #include <vector>
 
 namespace enrico {
@@ -30,6 +37,18 @@ public:
   //! while 'heat' sets temperature based on a thermal-fluids input (or restart) file.
   enum class Initial { neutronics, heat };
 
+  //! Enumeration of available schemes for exchanging coupling fields.
+  //! 'flat' exchanges messages between each heat rank and the neutronics root, while
+  //! 'hierarchical' aggregates each node's data in shared memory so that only one
+  //! message per node crosses the network.
+  enum class CommScheme { flat, hierarchical };
+
+  //! Enumeration of policies for when driver output is written in the Picard
+  //! iterations of a timestep.  'every' writes every output_interval_-th iteration,
+  //! 'converged' writes only the iteration that converged, and 'final' writes only the
+  //! last iteration, whether or not it converged.
+  enum class Output { every, converged, final };
+
   //! Initializes coupled neutron transport and thermal-hydraulics solver with
   //! the given MPI communicator
   //!
@@ -118,20 +137,57 @@ public:
   //! in the neutronics input file.
   Initial density_ic_{Initial::neutronics};
 
-  //! Report cumulative times for CoupledDriver member functions
-  void timer_report();
+  //! How coupling fields are exchanged between the heat and neutronics ranks. Defaults
+  //! to a flat exchange.
+  CommScheme comm_scheme_{CommScheme::flat};
+
+  //! Whether heat ranks that share a node with the neutronics root exchange coupling
+  //! fields with it through shared memory in the flat comm scheme. The hierarchical
+  //! comm scheme always uses shared memory within a node.
+  bool shared_memory_ = false;
+
+  //! How the ranks of each driver are chosen within a node. Defaults to the lowest
+  //! intranode ranks.
+  Placement placement_{Placement::block};
+
+  //! Number of NUMA domains per node used for placement. If <= 0, the domains are
+  //! queried from the MPI library.
+  int numa_domains_ = 0;
+
+  //! Output of a previous run whose solve times are used to choose the number of nodes
+  //! of each driver. If empty, the nodes given in the input are used.
+  std::string balance_nodes_file_;
+
+  //! Whether to rebalance the OpenMP threads of the drivers between timesteps on nodes
+  //! where they run on separate ranks
+  bool balance_threads_ = false;
+
+  //! Whether coupling fields sent between the neutronics root and heat ranks in the
+  //! flat comm scheme are losslessly compressed relative to their previous values
+  bool compression_ = false;
 
-  Timer timer_init_comms;         //!< For initialzing subcommunicators, etc.
-  Timer timer_init_mapping;       //!< For the init_mapping() member function
-  Timer timer_init_tallies;       //!< For the init_tallies() member function
-  Timer timer_init_volume;        //!< For the init_volume() member function
-  Timer timer_init_fluid_mask;    //!< For the init_fluid_mask() member function
-  Timer timer_init_temperature;   //!< For the init_temperature() member function
-  Timer timer_init_density;       //!< For the init_density() member function
-  Timer timer_init_heat_source;   //!< For the init_heat_source() member function
-  Timer timer_update_density;     //!< For the update_density() member function
-  Timer timer_update_heat_source; //!< For the update_heat_source() member function
-  Timer timer_update_temperature; //!< For the update_temperature() member function
+  //! Precision at which coupling fields are sent between the neutronics root and heat
+  //! ranks in the flat comm scheme.  Defaults to full (double) precision.
+  Precision field_precision_{Precision::full};
+
+  //! File to which a timeline of the timed regions of all ranks is written at the end
+  //! of execute(), or empty for no trace
+  std::string trace_file_;
+
+  //! When driver output is written in the Picard iterations of a timestep
+  Output output_{Output::every};
+
+  //! Number of Picard iterations between outputs for Output::every
+  int output_interval_ = 1;
+
+  //! Number of most recent outputs of each driver that are kept, or 0 to keep all
+  int output_keep_ = 0;
+
+  //! Report cumulative times of the regions timed in "CoupledDriver",
+  //! "NeutronicsDriver", and "HeatFluidsDriver", with their spread and imbalance over
+  //! ranks, and the communication and hardware counts if they are enabled.  Collective
+  //! over comm_.
+  void timer_report();
 
 private:
   //! Parse coupled driver's runtime parameters from enrico.xml
@@ -140,6 +196,28 @@ private:
   //! Create subcommunicators for single-physics drivers
   void init_comms(const pugi::xml_node& node);
 
+  //! Queries whether output_ calls for driver output in the current Picard iteration.
+  //! For Output::every, it is written after each driver's solve, and otherwise after
+  //! the convergence check.
+  //!
+  //! \param converged Whether the iteration converged
+  //! \return Whether the output is written
+  bool output_due(bool converged) const;
+
+  //! Write a driver's output for the current Picard iteration, and remove its oldest
+  //! output files if more than output_keep_ outputs have been written
+  //!
+  //! \param driver The driver, whose comm must be active
+  //! \param written Timestep and iteration of each output of the driver still kept
+  void write_output(Driver& driver, std::deque<std::array<int, 2>>& written);
+
+  //! Choose the number of nodes of each driver from the solve times in
+  //! balance_nodes_file_.  Collective over comm_.
+  //!
+  //! \param nodes The number of nodes each driver used in the run that wrote the file
+  //! \return The number of nodes for each driver
+  std::array<int, 2> balanced_nodes(std::array<int, 2> nodes) const;
+
   //! Create mappings between neutronics cell instances and heat/fluids elements
   void init_mapping();
 
@@ -156,6 +234,115 @@ private:
   //! Initialize fluid mask for local cells on each heat/fluids rank
   void init_fluid_mask();
 
+  //! Put the local cells of each heat rank in shared memory for the hierarchical comm
+  //! scheme or the flat comm scheme with shared memory.  Does nothing otherwise.
+  void init_shared_memory();
+
+  //! Gather the local cells of each node onto the neutronics root for the hierarchical
+  //! comm scheme
+  void init_hierarchical();
+
+  //! Send a local cell field from a heat rank to the neutronics root in the flat comm
+  //! scheme.  If the heat rank shares the root's node, the root reads it directly from
+  //! a shared-memory window.
+  //!
+  //! \param recvbuf Receive buffer, significant on the neutronics root
+  //! \param sendbuf Send buffer, significant on the heat rank
+  //! \param window Shared-memory window that holds the field on the heat rank's node
+  //! \param i Index of the heat rank in heat_ranks_
+  template<typename T, typename Buffer>
+  void recv_from_heat_rank(Buffer& recvbuf,
+                           Buffer& sendbuf,
+                           const SharedWindow<T>& window,
+                           gsl::index i);
+
+  //! Send a local cell field from the neutronics root to a heat rank in the flat comm
+  //! scheme.  If the heat rank shares the root's node, the root writes it directly to
+  //! a shared-memory window, and the heat rank must read it after the window's next
+  //! sync.
+  //!
+  //! \param recvbuf Receive buffer, significant on the heat rank
+  //! \param sendbuf Send buffer, significant on the neutronics root
+  //! \param window Shared-memory window that will hold the field on the root's node
+  //! \param i Index of the heat rank in heat_ranks_
+  template<typename T, typename Buffer>
+  void send_to_heat_rank(Buffer& recvbuf,
+                         Buffer& sendbuf,
+                         SharedWindow<T>& window,
+                         gsl::index i);
+
+  //! State for sending one coupling field between the neutronics root and heat ranks
+  struct FieldTransport {
+    //! Previous values sent by or to each heat rank, for compression.  On a heat rank,
+    //! only its own entry is used.
+    std::vector<std::vector<double>> references;
+
+    //! Largest absolute error of a value sent at reduced precision by the calling rank
+    //! since the last precision_report()
+    double max_error = 0.0;
+  };
+
+  //! Send a local cell field from a heat rank to the neutronics root, at reduced
+  //! precision or compressed if either is enabled and the heat rank does not share the
+  //! root's node
+  //!
+  //! \param transport The transport state of the field
+  //! \see recv_from_heat_rank
+  void recv_from_heat_rank(xt::xtensor<double, 1>& recvbuf,
+                           xt::xtensor<double, 1>& sendbuf,
+                           const SharedWindow<double>& window,
+                           gsl::index i,
+                           FieldTransport& transport);
+
+  //! Send a local cell field from the neutronics root to a heat rank, at reduced
+  //! precision or compressed if either is enabled and the heat rank does not share the
+  //! root's node
+  //!
+  //! \param transport The transport state of the field
+  //! \see send_to_heat_rank
+  void send_to_heat_rank(xt::xtensor<double, 1>& recvbuf,
+                         xt::xtensor<double, 1>& sendbuf,
+                         SharedWindow<double>& window,
+                         gsl::index i,
+                         FieldTransport& transport);
+
+  //! Whether a heat rank's local cell fields are sent to the neutronics root as one
+  //! message of CellRecord, i.e. at full precision, uncompressed, and not through
+  //! shared memory
+  //!
+  //! \param i Index of the heat rank in heat_ranks_
+  bool sends_cell_records(gsl::index i) const;
+
+  //! Send the local cells of a heat rank, with one field at each cell, to the
+  //! neutronics root as one message of CellRecord
+  //!
+  //! \param recvbuf Receive buffer, significant on the neutronics root
+  //! \param field The field at the local cells, significant on the heat rank
+  //! \param i Index of the heat rank in heat_ranks_
+  void recv_cell_records(std::vector<CellRecord>& recvbuf,
+                         const xt::xtensor<double, 1>& field,
+                         gsl::index i);
+
+  //! Report the largest errors induced by sending coupling fields at reduced precision
+  //! in the current Picard iteration, and reset them for the next one.  Does nothing at
+  //! full precision.  Collective over comm_.
+  void precision_report();
+
+  //! Volume-average a field over the local cells of all heat ranks with the
+  //! hierarchical comm scheme
+  //!
+  //! \param local_values The field at the local cells of the calling heat rank
+  //! \param fluid_only If true, only cells in the fluid contribute to the average
+  //! \return On neutronics ranks, the averaged field for each cell in coupled_cells_
+  std::vector<double> hierarchical_average(const xt::xtensor<double, 1>& local_values,
+                                           bool fluid_only);
+
+  //! Send the heat source from the neutronics root to the local cells of all heat ranks
+  //! with the hierarchical comm scheme
+  //!
+  //! \param all_cell_heat On the neutronics root, the heat source for all cells
+  void hierarchical_scatter(const xt::xtensor<double, 1>& all_cell_heat);
+
   //! Initialize current and previous Picard temperature fields
   void init_temperature();
 
@@ -169,12 +356,29 @@ private:
   //! this member function does not set any initial values.
   void init_heat_source();
 
+  //! Update the heat source for the thermal-hydraulics solver when the neutronics
+  //! driver gives it on a mesh or as an expansion.  The values in the basis are
+  //! broadcast from the neutronics root, and the heat source of each element is
+  //! evaluated at its centroid.
+  //!
+  //! \param relax Apply relaxation to heat source before updating heat solver
+  void update_basis_heat_source(bool relax);
+
   //! Print report of communicator layout if high verbosity is set
   void comm_report();
 
+  //! Split the cores of each node between the drivers according to their solve times
+  //! in the last timestep, by setting each driver's number of OpenMP threads.  Only
+  //! nodes where no rank runs both drivers are rebalanced.  Collective over comm_.
+  void balance_threads();
+
   //! Special alpha value indicating use of Robbins-Monro relaxation
   constexpr static double ROBBINS_MONRO = -1.0;
 
+  //! Largest relative difference between the heat source mapped to the heat/fluids
+  //! elements and the tallied heat source in a basis before a warning is printed
+  constexpr static double BASIS_POWER_TOLERANCE = 1e-2;
+
   int i_timestep_; //!< Index pertaining to current timestep
 
   int i_picard_; //!< Index pertaining to current Picard iteration
@@ -185,12 +389,105 @@ private:
   //! The rank in comm_ that corresponds to the root of the heat comm
   int heat_root_ = MPI_PROC_NULL;
 
+  //! Number of cores available to the calling rank, i.e., the most OpenMP threads of
+  //! the drivers it runs before any rebalancing
+  int rank_cores_ = 0;
+
+  //! Cumulative solve times of the neutronics and heat drivers at the last rebalancing
+  std::array<double, 2> solve_time_prev_{0.0, 0.0};
+
   //! List of ranks in this->comm_ that are in the heat/fluids subcomm
   std::vector<int> heat_ranks_;
 
   //! List of ranks in this->comm_ that are in the neutronics subcomm
   std::vector<int> neutronics_ranks_;
 
+  //! Ranks that share the calling rank's node
+  Comm intranode_comm_;
+
+  //! The root rank of each node.  Null on all other ranks.
+  Comm coupling_comm_;
+
+  //! The rank in coupling_comm_ that corresponds to the neutronics root.  Set only for
+  //! the hierarchical comm scheme.
+  int coupling_neutronics_root_ = MPI_PROC_NULL;
+
+  //! Ranks in coupling_comm_ whose nodes contain heat ranks.  Set only on the
+  //! neutronics root for the hierarchical comm scheme.
+  std::vector<int> heat_leaders_;
+
+  //! Offsets of each heat leader's data in the node-ordered entries.  Set only on the
+  //! neutronics root for the hierarchical comm scheme.
+  std::vector<std::size_t> heat_leader_offsets_;
+
+  //! Node-wide buffer of the local cells of each heat rank.  Set only when shared
+  //! memory is used.
+  SharedWindow<CellHandle> node_cells_;
+
+  //! Node-wide buffer of the local cell volumes of each heat rank.  Set only when
+  //! shared memory is used.
+  SharedWindow<double> node_volume_;
+
+  //! Node-wide buffer of the local cell fluid masks of each heat rank.  Set only when
+  //! shared memory is used.
+  SharedWindow<int> node_fluid_mask_;
+
+  //! Node-wide buffer of a local cell field, shared by the ranks of each node.  Set only
+  //! when shared memory is used.
+  SharedWindow<double> node_field_;
+
+  //! A cell field in node-ordered entries, as exchanged with the node roots.  Set only
+  //! on the neutronics root for the hierarchical comm scheme.
+  std::vector<double> entry_field_;
+
+  //! Persistent requests that send node_field_ from each node root to entry_field_ on
+  //! the neutronics root.  Set only for the hierarchical comm scheme.
+  PersistentRequests field_gather_;
+
+  //! Persistent requests that send entry_field_ from the neutronics root to node_field_
+  //! on each node root.  Set only for the hierarchical comm scheme.
+  PersistentRequests field_scatter_;
+
+  //! For each rank in heat_ranks_, its intranode rank if it shares a node with the
+  //! neutronics root, and -1 otherwise.  Set only for the flat comm scheme with
+  //! shared memory.
+  std::vector<int> heat_rank_segment_;
+
+  //! Whether the calling rank is a heat rank that shares a node with the neutronics
+  //! root.  Set only for the flat comm scheme with shared memory.
+  bool shares_neutronics_node_ = false;
+
+  FieldTransport temperature_transport_; //!< For temperatures sent by heat ranks
+  FieldTransport density_transport_;     //!< For densities sent by heat ranks
+  FieldTransport heat_source_transport_; //!< For heat sources sent to heat ranks
+
+  std::deque<std::array<int, 2>> neutronics_output_; //!< Kept neutronics outputs
+  std::deque<std::array<int, 2>> heat_output_;       //!< Kept heat-fluids outputs
+
+  //! Index in coupled_cells_ of each local cell of all heat ranks, in node order.  Set
+  //! only on the neutronics root for the hierarchical comm scheme.
+  std::vector<gsl::index> entry_to_coupled_cell_;
+
+  //! Volume of each local cell of all heat ranks, in node order.  Set only on the
+  //! neutronics root for the hierarchical comm scheme.
+  std::vector<double> entry_volume_;
+
+  //! Fluid mask of each local cell of all heat ranks, in node order.  Set only on the
+  //! neutronics root for the hierarchical comm scheme.
+  std::vector<int> entry_fluid_mask_;
+
+  //! Global cell handles of all cells that are coupled.  Set only on neutronics ranks
+  //! for the hierarchical comm scheme.
+  std::vector<CellHandle> coupled_cells_;
+
+  //! 1 if a cell in coupled_cells_ is in fluid, 0 if in solid.  Set only on neutronics
+  //! ranks for the hierarchical comm scheme.
+  std::vector<int> coupled_cell_fluid_mask_;
+
+  //! Total volume of each cell in coupled_cells_.  Set only on the neutronics root for
+  //! the hierarchical comm scheme.
+  std::vector<double> coupled_cell_volume_;
+
   //! Local cell temperature at current Picard iteration. Set only on heat/fluids ranks.
   xt::xtensor<double, 1> cell_temperature_;
 
@@ -209,6 +506,26 @@ private:
   //! Local cell heat source at previous Picard iteration. Set only on heat/fluids ranks.
   xt::xtensor<double, 1> cell_heat_source_prev_;
 
+  //! Offsets of each local element into elem_basis_index_ and elem_basis_weight_, with
+  //! one more entry for the end.  The heat source of element e is the sum of
+  //! weight * value over entries elem_basis_offset_[e] to elem_basis_offset_[e + 1].
+  //! Set only on heat/fluids ranks when the heat source is given in a basis.
+  std::vector<gsl::index> elem_basis_offset_;
+
+  //! Indices of the basis values that contribute to each local element's heat source
+  std::vector<gsl::index> elem_basis_index_;
+
+  //! Weights of the basis values that contribute to each local element's heat source
+  std::vector<double> elem_basis_weight_;
+
+  //! Local element heat source at current Picard iteration.  Set only on heat/fluids
+  //! ranks when the heat source is given in a basis.
+  xt::xtensor<double, 1> elem_heat_source_;
+
+  //! Local element heat source at previous Picard iteration.  Set only on heat/fluids
+  //! ranks when the heat source is given in a basis.
+  xt::xtensor<double, 1> elem_heat_source_prev_;
+
   std::unique_ptr<NeutronicsDriver> neutronics_driver_;  //!< The neutronics driver
   std::unique_ptr<HeatFluidsDriver> heat_fluids_driver_; //!< The heat-fluids driver
 
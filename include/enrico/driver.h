@@ -9,6 +9,7 @@
 
 #include <mpi.h>
 
+#include <string>
 #include <vector>
 
 #ifdef _OPENMP
@@ -18,17 +19,15 @@
 namespace enrico {
 
 //! Base class for driver that controls a physics solve
+//!
+//! Derived drivers time their setup and each step in regions of enrico::timers named
+//! "driver_setup", "init_step", "solve_step", "write_step", and "finalize_step".
 class Driver {
 public:
   //! Initializes the solver with the given MPI communicator.
   //! \param comm An existing MPI communicator used to initialize the solver
   explicit Driver(MPI_Comm comm)
     : comm_(comm)
-    , timer_driver_setup(comm_)
-    , timer_init_step(comm_)
-    , timer_solve_step(comm_)
-    , timer_write_step(comm_)
-    , timer_finalize_step(comm_)
   {
 #ifdef _OPENMP
 #pragma omp parallel default(none) shared(num_threads)
@@ -51,6 +50,16 @@ public:
   //! Write results for a physics solve at the end of the coupled simulation
   void write_step() { this->write_step(-1, -1); }
 
+  //! Get the files written by write_step for a given timestep and iteration, so that
+  //! they can be removed when no longer needed
+  //! \param timestep timestep index
+  //! \param iteration iteration index
+  //! \return Paths of the files, which are empty if the solver names its own files
+  virtual std::vector<std::string> output_files(int timestep, int iteration) const
+  {
+    return {};
+  }
+
   //! Performs the necessary finalization for this solver in one Picard iteration
   virtual void finalize_step() {}
 
@@ -60,12 +69,6 @@ public:
 
   Comm comm_; //!< The MPI communicator used to run the solver
 
-  Timer timer_driver_setup;  //!< For the setup function(s) of the external solver
-  Timer timer_init_step;     //!< For the init_step() member function
-  Timer timer_solve_step;    //!< For the solve_step() member function
-  Timer timer_write_step;    //!< For the write_step() member function
-  Timer timer_finalize_step; //!< For the finalize_step() member function
-
   //! Number of OpenMP threads
   int num_threads;
 };
@@ -3,6 +3,10 @@
 #ifndef ENRICO_GEOM_H
 #define ENRICO_GEOM_H
 
+#include "enrico/mpi_types.h"
+
+#include <tuple>
+
 namespace enrico {
 
 //! Describes an (x,y,z) coordinate in 3D space.
@@ -20,6 +24,15 @@ struct Position {
   double z{}; //!< z-coordinate
 };
 
+//! Positions are sent as three doubles
+template<>
+struct MpiRecord<Position> {
+  static auto members()
+  {
+    return std::make_tuple(&Position::x, &Position::y, &Position::z);
+  }
+};
+
 } // namespace enrico
 
 #endif // ENRICO_GEOM_H
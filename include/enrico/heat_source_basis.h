@@ -0,0 +1,49 @@
+//! \file heat_source_basis.h
+//! Interface for heat sources that are given as values combined at each position
+#ifndef ENRICO_HEAT_SOURCE_BASIS_H
+#define ENRICO_HEAT_SOURCE_BASIS_H
+
+#include "enrico/geom.h"
+
+#include <gsl/gsl>
+#include <xtensor/xtensor.hpp>
+
+#include <string>
+#include <vector>
+
+namespace enrico {
+
+//! A representation of a heat source as an array of values, such as mesh bins or
+//! expansion coefficients, that are combined linearly to give the heat source at any
+//! position
+class HeatSourceBasis {
+public:
+  virtual ~HeatSourceBasis() = default;
+
+  //! Get the number of values in the heat source
+  virtual std::size_t size() const = 0;
+
+  //! Get the values of the heat source that contribute at a position and their
+  //! weights, so that the heat source there is the sum of each value times its weight
+  //!
+  //! \param r The position in [cm]
+  //! \param indices Indices of the values, which are appended to
+  //! \param weights Weights of the values, which are appended to
+  virtual void weights(const Position& r,
+                       std::vector<gsl::index>& indices,
+                       std::vector<double>& weights) const = 0;
+
+  //! Integrate the heat source over the region that the basis covers
+  //!
+  //! \param values The values of the heat source in [W/cm^3]
+  //! \return The power in the region in [W]
+  virtual double integral(const xt::xtensor<double, 1>& values) const = 0;
+
+  //! Describe the region that the basis covers, for messages about positions outside
+  //! it, e.g. "the heat mesh"
+  virtual std::string region() const = 0;
+};
+
+} // namespace enrico
+
+#endif // ENRICO_HEAT_SOURCE_BASIS_H
@@ -0,0 +1,56 @@
+//! \file hw_counters.h
+//! Hardware performance counters of the calling thread
+#ifndef ENRICO_HW_COUNTERS_H
+#define ENRICO_HW_COUNTERS_H
+
+#include <cstdint>
+
+namespace enrico {
+
+//! Counts of hardware events
+struct HwCounts {
+  std::uint64_t cycles = 0;        //!< CPU cycles
+  std::uint64_t instructions = 0;  //!< Instructions retired
+  std::uint64_t cache_misses = 0;  //!< Last-level cache misses
+  std::uint64_t branch_misses = 0; //!< Mispredicted branches
+
+  HwCounts& operator+=(const HwCounts& other)
+  {
+    cycles += other.cycles;
+    instructions += other.instructions;
+    cache_misses += other.cache_misses;
+    branch_misses += other.branch_misses;
+    return *this;
+  }
+
+  HwCounts operator-(const HwCounts& other) const
+  {
+    return {cycles - other.cycles,
+            instructions - other.instructions,
+            cache_misses - other.cache_misses,
+            branch_misses - other.branch_misses};
+  }
+};
+
+//! Read the hardware counters of the calling thread, which count user-space events
+//! since they were first read on that thread.  The counters are opened with the Linux
+//! perf_event_open system call.  Events that the processor or kernel does not support
+//! are counted as 0.
+//!
+//! The counts include the threads that the calling thread starts after the counters
+//! are opened, e.g. OpenMP threads, if the kernel allows the counters to be inherited
+//! (see hw_counters_inherited()).  Otherwise they are for the calling thread only, and
+//! miss the work of threads that the calling thread started earlier in any case.
+//!
+//! \param counts The counts, set only if the counters could be read
+//! \return False if the counters are not available, e.g. if the system is not Linux
+//!   or /proc/sys/kernel/perf_event_paranoid forbids them
+bool read_hw_counters(HwCounts& counts);
+
+//! Whether the hardware counters of the calling thread include the threads it starts
+//! \return False if they count the calling thread only, or are not available
+bool hw_counters_inherited();
+
+} // namespace enrico
+
+#endif // ENRICO_HW_COUNTERS_H
@@ -0,0 +1,46 @@
+//! \file memory.h
+//! Memory use and heap allocations of the calling process
+#ifndef ENRICO_MEMORY_H
+#define ENRICO_MEMORY_H
+
+#include <cstddef>
+
+namespace enrico {
+
+//! Memory use of the calling process
+struct MemoryUsage {
+  std::size_t rss = 0; //!< Resident set size in bytes
+  std::size_t hwm = 0; //!< High-water mark of the resident set size in bytes
+};
+
+//! Heap allocations made through operator new by a thread
+struct AllocationCounts {
+  std::size_t allocated = 0;   //!< Bytes allocated
+  std::size_t freed = 0;       //!< Bytes freed
+  std::size_t allocations = 0; //!< Number of allocations
+};
+
+//! Memory use of a timed region, accumulated over the times it was closed
+struct MemoryCounts {
+  std::size_t rss = 0;         //!< Largest resident set size when the region closed
+  std::size_t hwm_growth = 0;  //!< Total growth of the high-water mark in the region
+  std::size_t allocated = 0;   //!< Bytes allocated in the region
+  std::size_t allocations = 0; //!< Number of allocations in the region
+};
+
+//! Read the memory use of the calling process from /proc/self/status
+//! \param usage The memory use, set only if it could be read
+//! \return False if /proc/self/status is not available
+bool read_memory_usage(MemoryUsage& usage);
+
+//! Queries whether heap allocations are counted, which requires building with the
+//! ENRICO_COUNT_ALLOCATIONS CMake option
+bool allocations_counted();
+
+//! Heap allocations made by the calling thread since it started, which are all 0 if
+//! allocations are not counted
+AllocationCounts thread_allocations();
+
+} // namespace enrico
+
+#endif // ENRICO_MEMORY_H
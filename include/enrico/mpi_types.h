@@ -5,6 +5,13 @@
 
 #include <mpi.h>
 
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility> // for index_sequence
+
 //! The ENRICO namespace
 namespace enrico {
 
@@ -14,6 +21,30 @@ namespace enrico {
 
 extern MPI_Datatype position_mpi_datatype;
 
+//==============================================================================
+// Traits
+//==============================================================================
+
+//! Lists the data members of a record type that make up its MPI datatype.
+//!
+//! To send a record (e.g., a cell handle with its temperature, volume, and density) in
+//! one message, specialize this trait with a static members() function that returns a
+//! tuple of pointers to the data members.  The record must be default constructible,
+//! and each member must be a type with an MPI datatype or a fixed-size array of one:
+//!
+//!   template<>
+//!   struct MpiRecord<CellField> {
+//!     static auto members()
+//!     {
+//!       return std::make_tuple(&CellField::cell, &CellField::T, &CellField::V);
+//!     }
+//!   };
+//!
+//! get_mpi_type<T>() then builds the datatype the first time it is called and caches
+//! it until free_mpi_datatypes(), after which the next call builds it again.
+template<typename T>
+struct MpiRecord;
+
 //==============================================================================
 // Functions
 //==============================================================================
@@ -24,10 +55,151 @@ void init_mpi_datatypes();
 //! Free any MPI datatypes
 void free_mpi_datatypes();
 
-//! Map types to corresponding MPI datatypes
+//! Keeps the committed MPI datatype of a type until free_mpi_datatypes() is called
+//! \param key The type that the datatype describes
+//! \param type A committed datatype
+void register_mpi_datatype(std::type_index key, MPI_Datatype type);
+
+//! Find the MPI datatype registered for a type
+//! \param key The type that the datatype describes
+//! \return The datatype, or MPI_DATATYPE_NULL if none is registered
+MPI_Datatype find_mpi_datatype(std::type_index key);
+
+//! Map types to corresponding MPI datatypes.  Types without a predefined MPI datatype
+//! must specialize MpiRecord.
 template<typename T>
 MPI_Datatype get_mpi_type();
 
+template<>
+MPI_Datatype get_mpi_type<char>();
+template<>
+MPI_Datatype get_mpi_type<unsigned char>();
+template<>
+MPI_Datatype get_mpi_type<short>();
+template<>
+MPI_Datatype get_mpi_type<int>();
+template<>
+MPI_Datatype get_mpi_type<long>();
+template<>
+MPI_Datatype get_mpi_type<long long>();
+template<>
+MPI_Datatype get_mpi_type<unsigned int>();
+template<>
+MPI_Datatype get_mpi_type<unsigned long>();
+template<>
+MPI_Datatype get_mpi_type<unsigned long long>();
+template<>
+MPI_Datatype get_mpi_type<float>();
+template<>
+MPI_Datatype get_mpi_type<double>();
+template<>
+MPI_Datatype get_mpi_type<bool>();
+
+//! Get an MPI datatype for equally-spaced blocks of values, e.g. a column of a
+//! row-major array.  Datatypes are cached by their arguments until
+//! free_mpi_datatypes().
+//!
+//! \param type Datatype of each value
+//! \param count Number of blocks
+//! \param blocklength Number of consecutive values in each block
+//! \param stride Number of values between the starts of consecutive blocks
+//! \return A committed datatype
+MPI_Datatype get_mpi_strided_type(MPI_Datatype type,
+                                  int count,
+                                  int blocklength,
+                                  int stride);
+
+//! Get an MPI datatype for equally-spaced blocks of values of type T
+template<typename T>
+MPI_Datatype get_mpi_strided_type(int count, int blocklength, int stride)
+{
+  return get_mpi_strided_type(get_mpi_type<T>(), count, blocklength, stride);
+}
+
+//! Get an MPI datatype for all values of a 1D strided view (e.g., an xt::view of one
+//! column of an xtensor), so the view can be sent from its first element's address
+//! without copying it into a contiguous buffer
+//!
+//! \param view A 1D view with size() and strides()
+//! \return A committed datatype spanning the view
+template<typename View>
+MPI_Datatype get_mpi_view_type(const View& view)
+{
+  using T = std::decay_t<typename View::value_type>;
+  return get_mpi_strided_type<T>(view.size(), 1, view.strides()[0]);
+}
+
+namespace detail {
+
+//! Describes a data member of a record in an MPI struct datatype
+template<typename M>
+struct MpiMember {
+  static int count() { return 1; }
+  static MPI_Datatype type() { return get_mpi_type<M>(); }
+};
+
+template<typename M, std::size_t N>
+struct MpiMember<M[N]> {
+  static int count() { return N * MpiMember<M>::count(); }
+  static MPI_Datatype type() { return MpiMember<M>::type(); }
+};
+
+//! The type of a data member, given a pointer to it
+template<typename Pointer>
+struct MemberType;
+
+template<typename T, typename M>
+struct MemberType<M T::*> {
+  using type = M;
+};
+
+template<typename T, typename Members, std::size_t... I>
+MPI_Datatype make_mpi_record_type(const Members& members, std::index_sequence<I...>)
+{
+  constexpr int n = sizeof...(I);
+  const T record{};
+  auto base = reinterpret_cast<const char*>(&record);
+
+  using std::tuple_element_t;
+  int blocklengths[n] = {
+    MpiMember<typename MemberType<tuple_element_t<I, Members>>::type>::count()...};
+  MPI_Datatype types[n] = {
+    MpiMember<typename MemberType<tuple_element_t<I, Members>>::type>::type()...};
+  MPI_Aint displs[n] = {
+    reinterpret_cast<const char*>(&(record.*std::get<I>(members))) - base...};
+
+  // Resize to the record's size so arrays of records include any trailing padding
+  MPI_Datatype packed, type;
+  MPI_Type_create_struct(n, blocklengths, displs, types, &packed);
+  MPI_Type_create_resized(packed, 0, sizeof(T), &type);
+  MPI_Type_free(&packed);
+  MPI_Type_commit(&type);
+  return type;
+}
+
+} // namespace detail
+
+//! Build the MPI datatype of a record type from its MpiRecord trait
+//! \return A committed datatype, which the caller must free
+template<typename T>
+MPI_Datatype make_mpi_record_type()
+{
+  auto members = MpiRecord<T>::members();
+  return detail::make_mpi_record_type<T>(
+    members, std::make_index_sequence<std::tuple_size<decltype(members)>::value>{});
+}
+
+template<typename T>
+MPI_Datatype get_mpi_type()
+{
+  auto type = find_mpi_datatype(typeid(T));
+  if (type == MPI_DATATYPE_NULL) {
+    type = make_mpi_record_type<T>();
+    register_mpi_datatype(typeid(T), type);
+  }
+  return type;
+}
+
 } // namespace enrico
 
 #endif // ENRICO_MPI_TYPES_H
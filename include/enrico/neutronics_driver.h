@@ -7,6 +7,7 @@
 #include "enrico/driver.h"
 #include "enrico/geom.h"
 #include "enrico/mpi_types.h"
+#include "enrico/heat_source_basis.h"
 
 #include <gsl/gsl>
 #include <xtensor/xtensor.hpp>
@@ -25,6 +26,10 @@ public:
   virtual ~NeutronicsDriver() = default;
 
   //! Get energy deposition in each material normalized to a given power
+  //!
+  //! This is collective over the neutronics comm, but only the root of the comm is
+  //! guaranteed to receive the full array. Other ranks may receive an empty array.
+  //!
   //! \param power User-specified power in [W]
   //! \return Heat source in each material as [W/cm3]
   virtual xt::xtensor<double, 1> heat_source(double power) const = 0;
@@ -84,6 +89,19 @@ public:
   //! \param cell An existing cell handle
   //! \return The index of the handle in the cells_ ordered mapping
   virtual gsl::index cell_index(CellHandle cell) const = 0;
+
+  //! Inform the driver of the temperature norm of the latest Picard iteration, which it
+  //! may use to reduce the work of the next solve as the coupled solution converges
+  //!
+  //! \param norm Norm of the temperature change between the last two iterations
+  virtual void set_temperature_norm(double norm) {}
+
+  //! Get the basis in which heat_source() is given, if it is given on a mesh or as an
+  //! expansion rather than for each cell.  The basis is available on every rank,
+  //! whether or not the driver's comm is active.
+  //!
+  //! \return The basis, or nullptr if the heat source is given for each cell
+  virtual const HeatSourceBasis* heat_basis() const { return nullptr; }
 };
 
 } // namespace enrico
@@ -6,13 +6,19 @@
 #include "enrico/cell_instance.h"
 #include "enrico/geom.h"
 #include "enrico/neutronics_driver.h"
+#include "enrico/pin_expansion.h"
+#include "enrico/regular_mesh.h"
 
+#include "openmc/bank.h"
 #include "openmc/cell.h"
 #include "openmc/tallies/filter_cell_instance.h"
 #include "openmc/tallies/tally.h"
 #include <gsl/gsl>
 #include <mpi.h>
+#include <pugixml.hpp>
 
+#include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -23,7 +29,8 @@ class OpenmcDriver : public NeutronicsDriver {
 public:
   //! One-time initalization of OpenMC and member variables
   //! \param comm An existing MPI communicator used to inialize OpenMC
-  explicit OpenmcDriver(MPI_Comm comm);
+  //! \param node XML node containing settings for the driver
+  OpenmcDriver(MPI_Comm comm, pugi::xml_node node);
 
   //! One-time finalization of OpenMC
   ~OpenmcDriver();
@@ -71,18 +78,36 @@ public:
   //! Create energy production tallies
   void create_tallies() override;
 
-  //! Determine number of cells participating in coupling
-  //! \return Number of cells
+  //! Get energy deposition in each material, in each bin of the heat mesh, or as the
+  //! expansion coefficients of each pin, normalized to a given power
+  //!
+  //! The heat source is only materialized on the root, from its reduced tally results.
+  //! Other ranks receive an empty array.
+  //!
+  //! \param power User-specified power in [W]
+  //! \return Heat source in each material or mesh bin, or its expansion coefficients,
+  //!   as [W/cm3]
   xt::xtensor<double, 1> heat_source(double power) const final;
 
+  //! Get the heat mesh or pin expansion on which the heat source is tallied
+  //! \return The basis, or nullptr if the heat source is tallied in cell instances
+  const HeatSourceBasis* heat_basis() const final;
+
   std::string cell_label(CellHandle cell) const;
 
   gsl::index cell_index(CellHandle cell) const override;
 
+  //! Record the temperature norm, which decides whether the next run from a carried-over
+  //! source uses the reduced number of inactive batches
+  //! \param norm Norm of the temperature change between the last two iterations
+  void set_temperature_norm(double norm) override { temperature_norm_ = norm; }
+
   //////////////////////////////////////////////////////////////////////////////
   // Driver interface
 
-  //! Initialization required in each Picard iteration
+  //! Initialization required in each Picard iteration.  In a warm re-run, the
+  //! simulation is only initialized in the first iteration, and later iterations only
+  //! reset the state that a new run needs.
   void init_step() final;
 
   //! Runs OpenMC for one Picard iteration
@@ -93,20 +118,75 @@ public:
   //! \param iteration iteration index
   void write_step(int timestep, int iteration) final;
 
-  //! Finalization required in each Picard iteration
+  //! Get the statepoint and properties files written for a timestep and iteration
+  //! \param timestep timestep index
+  //! \param iteration iteration index
+  //! \return Paths of the files
+  std::vector<std::string> output_files(int timestep, int iteration) const final;
+
+  //! Finalization required in each Picard iteration, which is deferred to the
+  //! destructor in a warm re-run
   void finalize_step() final;
 
 private:
+  //! Get the factor that normalizes tallied energy production to a given power
+  //!
+  //! This may only be called on the root of comm_, which holds the reduced results.
+  //!
+  //! \param power User-specified power in [W]
+  //! \return Factor that converts tallied energy production to [W]
+  double heat_source_norm(double power) const;
+
+  //! Create the energy production tally on heat_mesh_
+  void create_mesh_tally();
+
+  //! Create an energy production tally for each pin of heat_expansion_, with Zernike
+  //! and spatial Legendre filters
+  void create_expansion_tallies();
+
+  //! Reset an initialized simulation for another run, as openmc_simulation_finalize and
+  //! openmc_simulation_init would, but without freeing and reallocating the particle
+  //! banks, nuclide index mappings, and tally storage
+  void warm_reset();
+
+  //! Queries whether the next run starts from the fission source of the previous one
+  bool carries_source() const;
+
+  //! Set the numbers of inactive and total batches of the next run, reducing the
+  //! inactive batches if it starts from a carried-over source and temperatures have
+  //! nearly converged.  The number of active batches is not changed.
+  void set_batches() const;
+
   CellInstance& cell_instance(CellHandle cell);
   const CellInstance& cell_instance(CellHandle cell) const;
 
   // Data members
-  openmc::Tally* tally_;               //!< Fission energy deposition tally
-  openmc::CellInstanceFilter* filter_; //!< Cell instance filter
-  std::vector<CellInstance> cells_;    //!< Array of cell instances
+  openmc::Tally* tally_;                   //!< Energy deposition tally
+  openmc::Tally* global_tally_ = nullptr;  //!< Unfiltered tally that normalizes tally_
+  std::string heating_score_ = "kappa-fission"; //!< Score of the heat source tallies
+  bool photon_transport_ = false; //!< Whether photons are transported and deposit heat
+  openmc::CellInstanceFilter* filter_;     //!< Cell instance filter
+  std::unique_ptr<RegularMesh> heat_mesh_; //!< Mesh of the tally, or nullptr for cells
+  std::unique_ptr<PinExpansion> heat_expansion_; //!< Pin expansion, or nullptr
+  std::vector<openmc::Tally*> expansion_tallies_; //!< Tally of each expanded pin
+
+  //! Reciprocal volume of each bin of tally_, or the scale of each coefficient of a pin
+  //! expansion, which converts tallied energy in [W] to [W/cm^3].  Set only on the root
+  //! when the tallies are created.
+  xt::xtensor<double, 1> bin_scale_;
+  std::vector<CellInstance> cells_;        //!< Array of cell instances
   std::unordered_map<CellHandle, gsl::index>
     cell_index_;            //!< Map handles to index in cells_
   int n_fissionable_cells_; //!< Number of fissionable cells in model
+  bool warm_rerun_ = false; //!< Whether the simulation is kept across Picard iterations
+
+  bool carry_source_ = false; //!< Whether each run starts from the previous fission source
+  int carry_inactive_ = -1;   //!< Inactive batches from a carried-over source, or -1
+  double carry_norm_;         //!< Largest temperature norm that uses carry_inactive_
+  double temperature_norm_;   //!< Temperature norm of the latest Picard iteration
+  int n_inactive_;            //!< Number of inactive batches in settings.xml
+  int n_batches_;             //!< Number of batches in settings.xml
+  std::vector<openmc::SourceSite> source_; //!< Fission source saved from the last run
 };
 
 } // namespace enrico
@@ -0,0 +1,116 @@
+//! \file pin_expansion.h
+//! Functional expansions of the heat source in cylindrical pins
+#ifndef ENRICO_PIN_EXPANSION_H
+#define ENRICO_PIN_EXPANSION_H
+
+#include "enrico/geom.h"
+#include "enrico/heat_source_basis.h"
+
+#include <gsl/gsl>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace enrico {
+
+//! Evaluate the Zernike polynomials up to a given order on the unit disk, ordered and
+//! normalized as in OpenMC's Zernike filter: Z_0^0, Z_1^-1, Z_1^1, Z_2^-2, Z_2^0, ...,
+//! with the integral of each squared polynomial over the disk equal to pi.  Polynomials
+//! with m < 0 vary as sin(|m| phi) and the others as cos(m phi).
+//!
+//! \param order Largest radial order n
+//! \param rho Radius relative to the radius of the disk, in [0, 1]
+//! \param phi Azimuthal angle in radians
+//! \return The (order + 1)(order + 2)/2 polynomials
+std::vector<double> zernike(int order, double rho, double phi);
+
+//! Evaluate the Legendre polynomials up to a given order
+//! \param order Largest order
+//! \param x Position in [-1, 1]
+//! \return The order + 1 polynomials
+std::vector<double> legendre(int order, double x);
+
+//! A heat source in a set of identical, axially aligned cylindrical pins, each expanded
+//! in Zernike polynomials radially and Legendre polynomials axially.  The values of the
+//! heat source are the expansion coefficients of each pin in turn, with those of each
+//! pin ordered by Zernike polynomial and then by Legendre polynomial.
+class PinExpansion : public HeatSourceBasis {
+public:
+  //! Create an expansion
+  //! \param centers (x, y) coordinates of the center of each pin in [cm]
+  //! \param radius Radius of the pins in [cm]
+  //! \param z_min Bottom of the pins in [cm]
+  //! \param z_max Top of the pins in [cm]
+  //! \param zernike_order Largest radial order of the Zernike polynomials
+  //! \param legendre_order Largest order of the Legendre polynomials
+  PinExpansion(std::vector<std::array<double, 2>> centers,
+               double radius,
+               double z_min,
+               double z_max,
+               int zernike_order,
+               int legendre_order);
+
+  //! Get the number of pins
+  std::size_t n_pins() const { return centers_.size(); }
+
+  //! Get the number of Zernike polynomials
+  std::size_t n_zernike() const
+  {
+    return (zernike_order_ + 1) * (zernike_order_ + 2) / 2;
+  }
+
+  //! Get the number of Legendre polynomials
+  std::size_t n_legendre() const { return legendre_order_ + 1; }
+
+  //! Get the number of expansion coefficients of each pin
+  std::size_t n_coefficients() const { return n_zernike() * n_legendre(); }
+
+  std::size_t size() const override { return n_pins() * n_coefficients(); }
+
+  //! Find the pin that contains a position
+  //! \param r The position in [cm]
+  //! \return Index of the pin, or -1 if the position is in no pin
+  gsl::index pin(const Position& r) const;
+
+  //! Get the factor that converts an integral of the heat source times a product of
+  //! polynomials over a pin, as tallied by OpenMC, into the expansion coefficient of
+  //! that product
+  //!
+  //! \param k Index of the coefficient within a pin
+  //! \return The factor in [1/cm^3]
+  double coefficient_scale(gsl::index k) const;
+
+  //! Get the coefficients of the pin that contains a position and their weights, which
+  //! are the products of polynomials at the position
+  //!
+  //! \param r The position in [cm]
+  //! \param indices Indices of the coefficients, which are appended if the position is
+  //!   in a pin
+  //! \param weights Weights of the coefficients, which are appended if the position is
+  //!   in a pin
+  void weights(const Position& r,
+               std::vector<gsl::index>& indices,
+               std::vector<double>& weights) const override;
+
+  //! Integrate the heat source over the pins.  Every polynomial but Z_0^0 P_0 = 1
+  //! integrates to 0 over a pin, so only that coefficient of each pin contributes.
+  //!
+  //! \param values The expansion coefficients of each pin in [W/cm^3]
+  //! \return The power in the pins in [W]
+  double integral(const xt::xtensor<double, 1>& values) const override;
+
+  std::string region() const override { return "the pins of the heat expansion"; }
+
+  std::vector<std::array<double, 2>> centers_; //!< (x, y) of each pin center in [cm]
+  double radius_;                              //!< Radius of the pins in [cm]
+  double z_min_;                               //!< Bottom of the pins in [cm]
+  double z_max_;                               //!< Top of the pins in [cm]
+  int zernike_order_;                          //!< Largest Zernike radial order
+  int legendre_order_;                         //!< Largest Legendre order
+};
+
+} // namespace enrico
+
+#endif // ENRICO_PIN_EXPANSION_H
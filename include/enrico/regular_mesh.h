@@ -0,0 +1,63 @@
+//! \file regular_mesh.h
+//! A regular Cartesian mesh on which a heat source can be tallied
+#ifndef ENRICO_REGULAR_MESH_H
+#define ENRICO_REGULAR_MESH_H
+
+#include "enrico/geom.h"
+#include "enrico/heat_source_basis.h"
+
+#include <gsl/gsl>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace enrico {
+
+//! A regular Cartesian mesh of equal, box-shaped bins.  Bins are numbered with x
+//! varying fastest and z slowest, as in OpenMC's regular mesh.
+class RegularMesh : public HeatSourceBasis {
+public:
+  //! Create a mesh over a box
+  //! \param lower_left Lower-left corner of the box in [cm]
+  //! \param upper_right Upper-right corner of the box in [cm]
+  //! \param dimension Number of bins along x, y, and z
+  RegularMesh(Position lower_left, Position upper_right, std::array<int, 3> dimension);
+
+  //! Get the index of the bin that contains a position
+  //! \param r The position in [cm]
+  //! \return Index of the bin, or -1 if the position is outside the mesh
+  gsl::index bin(const Position& r) const;
+
+  //! Get the total number of bins
+  std::size_t n_bins() const;
+
+  std::size_t size() const override { return n_bins(); }
+
+  //! Get the bin that contains a position, whose weight is 1
+  //! \param r The position in [cm]
+  //! \param indices Index of the bin, which is appended if the position is in the mesh
+  //! \param weights Weight of the bin, which is appended if the position is in the mesh
+  void weights(const Position& r,
+               std::vector<gsl::index>& indices,
+               std::vector<double>& weights) const override;
+
+  //! Sum the heat source over the bins
+  //! \param values The heat source in each bin in [W/cm^3]
+  //! \return The power in the mesh in [W]
+  double integral(const xt::xtensor<double, 1>& values) const override;
+
+  std::string region() const override { return "the heat mesh"; }
+
+  //! Get the volume of each bin in [cm^3]
+  double bin_volume() const;
+
+  Position lower_left_;          //!< Lower-left corner in [cm]
+  Position upper_right_;         //!< Upper-right corner in [cm]
+  std::array<int, 3> dimension_; //!< Number of bins along x, y, and z
+};
+
+} // namespace enrico
+
+#endif // ENRICO_REGULAR_MESH_H
@@ -0,0 +1,155 @@
+//! \file shared_window.h
+//! Shared-memory buffer spanning the ranks of a node
+#ifndef ENRICO_SHARED_WINDOW_H
+#define ENRICO_SHARED_WINDOW_H
+
+#include "enrico/comm.h"
+#include "enrico/mpi_types.h"
+
+#include <mpi.h>
+
+#include <cstddef>
+#include <utility> // for swap
+#include <vector>
+
+namespace enrico {
+
+//! A buffer in shared memory, allocated with MPI_Win_allocate_shared, that is split into
+//! one contiguous segment per rank of an intranode comm.
+//!
+//! Segments are laid out consecutively in rank order, so the whole node's data can be
+//! read or written in one piece from any rank with plain loads and stores.  Stores only
+//! become visible to other ranks after a call to sync().
+template<typename T>
+class SharedWindow {
+public:
+  //! Default constructor
+  SharedWindow() = default;
+
+  //! Allocates the window.  Collective over comm.
+  //!
+  //! \param comm A comm whose ranks all share memory (e.g. the intranode comm)
+  //! \param n_local Number of values in the calling rank's segment
+  SharedWindow(const Comm& comm, std::size_t n_local);
+
+  //! Frees the window.  Collective over the comm it was allocated on.
+  ~SharedWindow() { free(); }
+
+  SharedWindow(const SharedWindow&) = delete;
+  SharedWindow& operator=(const SharedWindow&) = delete;
+
+  SharedWindow(SharedWindow&& other) noexcept { swap(other); }
+
+  SharedWindow& operator=(SharedWindow&& other) noexcept
+  {
+    swap(other);
+    return *this;
+  }
+
+  //! Frees the window.  Collective over the comm it was allocated on.
+  void free();
+
+  //! Queries whether the window has been allocated
+  //! \return True if the window is allocated
+  bool active() const { return win_ != MPI_WIN_NULL; }
+
+  //! Makes all stores to the window visible to all ranks of the comm.  Collective.
+  void sync() const;
+
+  //! Start of the whole node's buffer (i.e., of the segment of rank 0)
+  T* data() const { return base_; }
+
+  //! Start of the calling rank's segment
+  T* local_data() const { return base_ + offsets_.at(comm_.rank); }
+
+  //! Number of values in the whole node's buffer
+  std::size_t size() const { return offsets_.empty() ? 0 : offsets_.back(); }
+
+  //! Number of values in the calling rank's segment
+  std::size_t local_size() const { return segment_size(comm_.rank); }
+
+  //! Number of values in a given rank's segment
+  //! \param rank A rank in the comm
+  std::size_t segment_size(int rank) const
+  {
+    return offsets_.at(rank + 1) - offsets_.at(rank);
+  }
+
+  //! Offset of a given rank's segment from the start of the node's buffer
+  //! \param rank A rank in the comm
+  std::size_t segment_offset(int rank) const { return offsets_.at(rank); }
+
+private:
+  void swap(SharedWindow& other) noexcept
+  {
+    std::swap(comm_, other.comm_);
+    std::swap(win_, other.win_);
+    std::swap(base_, other.base_);
+    std::swap(offsets_, other.offsets_);
+  }
+
+  Comm comm_;                        //!< The comm over which the window is shared
+  MPI_Win win_ = MPI_WIN_NULL;       //!< The underlying MPI window
+  T* base_ = nullptr;                //!< Start of the node's buffer
+  std::vector<std::size_t> offsets_; //!< Segment offsets, with the total size appended
+};
+
+template<typename T>
+SharedWindow<T>::SharedWindow(const Comm& comm, std::size_t n_local)
+  : comm_(comm)
+{
+  if (!comm_.active()) {
+    return;
+  }
+
+  // Every rank needs every segment's offset to find data in the node's buffer
+  std::vector<std::size_t> counts(comm_.size);
+  comm_.Allgather(&n_local,
+                  1,
+                  get_mpi_type<std::size_t>(),
+                  counts.data(),
+                  1,
+                  get_mpi_type<std::size_t>());
+  offsets_.assign(comm_.size + 1, 0);
+  for (int i = 0; i < comm_.size; ++i) {
+    offsets_[i + 1] = offsets_[i] + counts[i];
+  }
+
+  T* local_base;
+  MPI_Win_allocate_shared(
+    n_local * sizeof(T), sizeof(T), MPI_INFO_NULL, comm_.comm, &local_base, &win_);
+
+  // Segments are contiguous, so the node's buffer starts at the first nonempty segment
+  MPI_Aint size;
+  int disp_unit;
+  MPI_Win_shared_query(win_, MPI_PROC_NULL, &size, &disp_unit, &base_);
+
+  // Keep a passive epoch open for the window's lifetime, so sync() only needs to
+  // flush memory and synchronize the ranks
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, win_);
+}
+
+template<typename T>
+void SharedWindow<T>::free()
+{
+  if (active()) {
+    MPI_Win_unlock_all(win_);
+    MPI_Win_free(&win_);
+    base_ = nullptr;
+    offsets_.clear();
+  }
+}
+
+template<typename T>
+void SharedWindow<T>::sync() const
+{
+  if (active()) {
+    MPI_Win_sync(win_);
+    comm_.Barrier();
+    MPI_Win_sync(win_);
+  }
+}
+
+} // namespace enrico
+
+#endif // ENRICO_SHARED_WINDOW_H
@@ -242,6 +242,12 @@ public:
   //! Write data to VTK
   void write_step(int timestep, int iteration) final;
 
+  //! Get the VTK file written for a timestep and iteration
+  //! \param timestep timestep index
+  //! \param iteration iteration index
+  //! \return Path of the file, or nothing if no file is written for the iteration
+  std::vector<std::string> output_files(int timestep, int iteration) const final;
+
   //! Returns solid temperature in [K] for given region
   double solid_temperature(std::size_t pin, std::size_t axial, std::size_t ring) const;
 
@@ -296,6 +302,12 @@ public:
   size_t vtk_radial_res_{20};      //!< radial resolution of resulting vtk files
 
 private:
+  //! Get the name of the VTK file for a timestep and iteration
+  //! \param timestep timestep index, or -1 at the end of the simulation
+  //! \param iteration iteration index, or -1 at the end of the simulation
+  //! \return Name of the file
+  std::string vtk_filename(int timestep, int iteration) const;
+
   //! Get temperature of local mesh elements
   //! \return Temperature of local mesh elements in [K]
   std::vector<double> temperature() const override;
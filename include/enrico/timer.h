@@ -2,52 +2,19 @@
 #define ENRICO_INCLUDE_ENRICO_TIMER_H
 
 #include "comm.h"
+#include "hw_counters.h"
+#include "memory.h"
+#include <atomic>
+#include <chrono>
 #include <iomanip>
+#include <istream>
+#include <map>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace enrico {
 
-//! Class for measuring and collecting time on a given MPI communicator
-class Timer {
-public:
-  //! Initializes timer for a given MPI communicator
-  //! \param comm The MPI communicator for which time is measured
-  explicit Timer(const Comm& comm)
-    : comm_(comm)
-  {}
-
-  //! Begin accumulating elapsed time.
-  //!
-  //! If the timer has been previously stopped, then restarting it will
-  //! not reset elapsed time at 0.
-  void start();
-
-  //! Stop accumulating elapsed time.
-  //!
-  //! This does not reset elapsed time to 0.
-  void stop();
-
-  //! Accumulated time between all consecutive calls to start() and stop()
-  //!
-  //! If the timer is currently running, then this returns the elapsed time
-  //! at the time of the function call.
-  //!
-  //! If the timer is not currently running (i.e., has been stopped), then this returns
-  //! the accumulated elapsed time from the time it was stopped.
-  //!
-  //! \return Elapsed time in seconds.
-  double elapsed();
-
-  //! Reset the elapsed time to 0.
-  void reset();
-
-private:
-  const Comm comm_;      //!< MPI comm for which this instance measures time
-  double start_ = 0.0;   //!< Start time at most recent call to start()
-  double elapsed_ = 0.0; //!< Time accumulated between all consecutive start/stops
-  bool running_ = false; //!< True if started; false if stopped
-};
-
 //! Class for storing times associated with an arbitrary label
 class TimeAmt {
 public:
@@ -55,11 +22,15 @@ public:
     : name(name){};
   TimeAmt(const std::string& name, double time)
     : name(name)
-    , time(time){};
+    , time(time)
+    , min(time)
+    , avg(time){};
   TimeAmt(const std::string& name, double time, double percent)
     : name(name)
     , time(time)
-    , percent(percent){};
+    , percent(percent)
+    , min(time)
+    , avg(time){};
 
   //! Get the total time for a vector of TimeAmt
   static double sum_times(const std::vector<TimeAmt>& times);
@@ -76,11 +47,210 @@ public:
                           const std::vector<TimeAmt>& times,
                           const Comm& comm);
 
+  //! Print the imbalance of times over ranks for a vector of TimeAmt, i.e. the ratio
+  //! of each largest time to its average, and the rank with the largest time
+  //!
+  //! \param header_name An arbitrary header that is printed
+  //! \param times Each TimeAmt is printed on a separate line
+  //! \param comm The root process of this Comm will print the output
+  static void print_imbalance(const std::string& header_name,
+                              const std::vector<TimeAmt>& times,
+                              const Comm& comm);
+
+  //! Read the times printed by print_times for a given header, e.g. from the output of
+  //! a previous run.  If the header was printed more than once, the last times are read.
+  //!
+  //! \param is The stream to read from
+  //! \param header_name The header that was printed with the times
+  //! \return The times, which are empty if the header is not found
+  static std::vector<TimeAmt> read_times(std::istream& is, const std::string& header_name);
+
   const std::string name; //!< Arbitrary label
   double time;            //!< The time in arbitrary units
   double percent;         //!< The percent wrt. a total time
+  double min;             //!< The smallest time over ranks
+  double avg;             //!< The average time over ranks
+  int slowest = 0;        //!< The rank with the largest time
+
+  //! Ratio of the largest time to the average time over ranks, which is 1 if balanced
+  double imbalance() const { return avg > 0.0 ? time / avg : 1.0; }
+};
+
+//! Registry of named, nestable timers, measured with each rank's local clock.
+//!
+//! Time is accumulated in regions opened with scope(), which are closed when the
+//! returned Scope is destroyed.  A region opened while another is open on the same
+//! thread is nested in it, and its path is the enclosing region's path, a "/", and its
+//! name.  Regions don't synchronize ranks unless a comm is given, so the times of
+//! different ranks are only combined by aggregate().  Regions may be opened from any
+//! thread; each thread nests its own regions.
+//!
+//! After start_trace(), every closed region is also recorded as an event with its start
+//! and end, and the events of all ranks can be written to a trace file by write_trace().
+//!
+//! After enable_hw_counters(), the hardware counters of the thread that opens a region
+//! are also accumulated for its path and can be reported by hw_report().  They include
+//! the threads it starts only where the kernel allows (see read_hw_counters()).
+//! Likewise, after enable_memory_tracking(), the memory use of the process and the
+//! allocations of the thread that opens a region are accumulated and can be reported
+//! by memory_report().
+class TimerRegistry {
+public:
+  //! An open timed region, which is closed when destroyed
+  class Scope {
+  public:
+    Scope(Scope&& other) noexcept;
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    Scope& operator=(Scope&&) = delete;
+
+  private:
+    friend class TimerRegistry;
+    Scope(TimerRegistry& registry,
+          const std::string& name,
+          const Comm* comm,
+          bool nested = true);
+
+    TimerRegistry* registry_; //!< The registry, or nullptr if moved from
+    std::string path_;        //!< Full path of the region
+    const Comm* comm_;        //!< Comm to synchronize on, or nullptr
+    bool nested_;             //!< Whether the region is timed and nests others
+    bool counted_ = false;    //!< Whether hardware counters are accumulated
+    HwCounts counts_;         //!< Hardware counts when the region was opened
+    bool tracked_ = false;    //!< Whether memory use is accumulated
+    MemoryUsage memory_;      //!< Memory use when the region was opened
+    AllocationCounts allocations_; //!< Allocations when the region was opened
+    std::chrono::steady_clock::time_point start_; //!< When the region was opened
+  };
+
+  //! Open a timed region nested in the innermost open region of the calling thread
+  //! \param name Name of the region, which may itself contain "/"
+  //! \return The open region
+  Scope scope(const std::string& name) { return Scope{*this, name, nullptr}; }
+
+  //! Open a timed region, synchronizing the ranks of a comm when it is opened and
+  //! closed.  Collective over comm.
+  //! \param name Name of the region
+  //! \param comm The comm to synchronize
+  //! \return The open region
+  Scope scope(const std::string& name, const Comm& comm)
+  {
+    return Scope{*this, name, &comm};
+  }
+
+  //! Open a region that is only recorded as a trace event.  It is not timed, and
+  //! regions opened in it are not nested in it, so it can mark spans such as
+  //! iterations without changing the paths of the regions they contain.
+  //! \param name Name of the event
+  //! \return The open region
+  Scope trace(const std::string& name) { return Scope{*this, name, nullptr, false}; }
+
+  //! Start recording closed regions as trace events, discarding any recorded earlier.
+  //! The start of the trace is synchronized over a comm, so that events of different
+  //! ranks share a time origin.  Collective over comm.
+  //! \param comm The comm over which the trace is synchronized
+  void start_trace(const Comm& comm);
+
+  //! Write the events recorded on each rank of a comm to a file in the Chrome trace
+  //! event format, which can be viewed with chrome://tracing or Perfetto.  Each rank is
+  //! shown as a process and each of its threads as a track.  The file holds one event
+  //! per line.  Collective over comm.
+  //! \param filename Path of the file, which is written by the root of comm
+  //! \param comm The comm whose events are written
+  void write_trace(const std::string& filename, const Comm& comm) const;
+
+  //! Turn accumulation of hardware counters in timed regions on or off
+  void enable_hw_counters(bool on) { hw_counting_ = on; }
+
+  //! Queries whether hardware counters are accumulated in timed regions
+  bool hw_counters_enabled() const { return hw_counting_; }
+
+  //! Print the hardware counts of each region path, summed over the ranks of a comm,
+  //! with derived rates and the rank with the fewest instructions per cycle.  The report
+  //! says whether the counts include threads started by the timed threads or are for
+  //! the timed threads only.  Collective over comm.
+  //! \param comm The comm over which counts are combined
+  void hw_report(const Comm& comm) const;
+
+  //! Turn accumulation of memory use in timed regions on or off
+  void enable_memory_tracking(bool on) { memory_tracking_ = on; }
+
+  //! Queries whether memory use is accumulated in timed regions
+  bool memory_tracking_enabled() const { return memory_tracking_; }
+
+  //! Print the high-water mark of each rank of a comm, and for each region path, the
+  //! largest resident set size and high-water-mark growth over ranks with the ranks they
+  //! came from, and the allocations summed over ranks if they are counted.  Collective
+  //! over comm.
+  //! \param comm The comm over which memory use is combined
+  void memory_report(const Comm& comm) const;
+
+  //! Path of the innermost region open on the calling thread
+  //! \return The path, which is empty if no region is open
+  static std::string current_path();
+
+  //! Time accumulated by the calling rank in closed regions with a given path
+  //! \param path Full path of the regions
+  //! \return Elapsed time in seconds, which is 0 if no such region was closed
+  double elapsed(const std::string& path) const;
+
+  //! Combine the times of the regions directly nested in a given path over a comm.
+  //! Collective over comm.
+  //!
+  //! The time of each region is its largest time over the ranks that closed it, and
+  //! its min, avg, and slowest rank are over the same ranks.
+  //!
+  //! \param path Full path of the enclosing region
+  //! \param comm The comm over which times are combined
+  //! \return The times, sorted by name (significant at root)
+  std::vector<TimeAmt> aggregate(const std::string& path, const Comm& comm) const;
+
+  //! Reset all times to 0
+  void reset();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  //! A closed region recorded for the trace
+  struct Event {
+    std::string path; //!< Full path of the region
+    double start;     //!< Time it was opened in microseconds since the trace started
+    double duration;  //!< Time it was open in microseconds
+    int thread;       //!< Index of the thread that opened it
+  };
+
+  //! Record a closed region
+  //! \param path Full path of the region
+  //! \param start When the region was opened
+  //! \param end When the region was closed
+  //! \param timed Whether to add the region's time to its path
+  void add(const std::string& path,
+           Clock::time_point start,
+           Clock::time_point end,
+           bool timed);
+
+  //! Add hardware counts to the regions with a given path
+  void add_hw(const std::string& path, const HwCounts& counts);
+
+  //! Add the memory use of a closed region to the regions with a given path
+  void add_memory(const std::string& path, const MemoryCounts& counts);
+
+  mutable std::mutex mutex_;                  //!< Guards times_, events_, and counts
+  std::map<std::string, double> times_;       //!< Accumulated time of each path
+  std::atomic<bool> hw_counting_{false};      //!< Whether hardware counts are kept
+  std::map<std::string, HwCounts> hw_counts_; //!< Accumulated counts of each path
+  std::atomic<bool> memory_tracking_{false};  //!< Whether memory use is kept
+  std::map<std::string, MemoryCounts> memory_counts_; //!< Memory use of each path
+  bool tracing_ = false;                //!< Whether closed regions are recorded
+  Clock::time_point trace_start_;       //!< Origin of the times of events
+  std::vector<Event> events_;           //!< Regions closed since the trace started
 };
 
+//! Timers of the calling process, shared by all drivers
+extern TimerRegistry timers;
+
 }
 
 #endif // ENRICO_INCLUDE_ENRICO_TIMER_H
@@ -0,0 +1,113 @@
+#include "enrico/comm_counters.h"
+
+#include "enrico/comm.h"
+#include "enrico/timer.h"
+
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace enrico {
+
+CommCounters comm_counters;
+
+void CommCounters::add(const char* name,
+                       double seconds,
+                       std::size_t bytes,
+                       std::size_t messages)
+{
+  auto site = TimerRegistry::current_path();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& count = counts_[{site.empty() ? "-" : site, name}];
+  count.seconds += seconds;
+  ++count.calls;
+  count.messages += messages;
+  count.bytes += bytes;
+}
+
+void CommCounters::add_persistent(MPI_Request request, std::size_t bytes)
+{
+  if (enabled() && request != MPI_REQUEST_NULL) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    persistent_[request] = bytes;
+  }
+}
+
+void CommCounters::remove_persistent(MPI_Request request)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  persistent_.erase(request);
+}
+
+void CommCounters::sent_persistent(Op& op, MPI_Request request) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = persistent_.find(request);
+  if (it != persistent_.end()) {
+    op.sent(it->second);
+  }
+}
+
+void CommCounters::reset()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  counts_.clear();
+}
+
+CommCounters::Count CommCounters::get(const std::string& site,
+                                      const std::string& name) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = counts_.find({site, name});
+  return it != counts_.end() ? it->second : Count{};
+}
+
+void CommCounters::report(const Comm& comm) const
+{
+  if (!comm.active()) {
+    return;
+  }
+
+  // Call sites and operations are combined into one name, so ranks can agree on them
+  std::map<std::string, Count> local;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& c : counts_) {
+      local.emplace(c.first.first + '\t' + c.first.second, c.second);
+    }
+  }
+  std::set<std::string> names;
+  for (const auto& c : local) {
+    names.insert(c.first);
+  }
+  auto keys = comm.union_names(names);
+
+  const std::size_t n = keys.size();
+  std::vector<double> seconds(n, 0.0);
+  std::vector<std::size_t> sums(3 * n, 0);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto it = local.find(keys[i]);
+    if (it != local.end()) {
+      seconds[i] = it->second.seconds;
+      sums[i] = it->second.calls;
+      sums[n + i] = it->second.messages;
+      sums[2 * n + i] = it->second.bytes;
+    }
+  }
+  comm.reduce(seconds, MPI_MAX);
+  comm.reduce(sums, MPI_SUM);
+
+  comm.message("  Communication (calls, messages, bytes, seconds)");
+  for (std::size_t i = 0; i < n; ++i) {
+    auto tab = keys[i].find('\t');
+    std::stringstream msg;
+    msg << "    " << std::setw(36) << std::left << keys[i].substr(0, tab)
+        << std::setw(22) << keys[i].substr(tab + 1) << std::right << std::setw(10)
+        << sums[i] << std::setw(10) << sums[n + i] << std::setw(14) << sums[2 * n + i]
+        << "    " << std::scientific << std::setprecision(4) << seconds[i];
+    comm.message(msg.str());
+  }
+}
+
+} // namespace enrico
@@ -1,11 +1,146 @@
 #include "enrico/comm_split.h"
 #include <gsl/gsl>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
 namespace enrico {
 
+namespace {
+
+//! Finds the NUMA domain of every rank in a node
+//!
+//! \param intranode_comm A comm that spans the node
+//! \param numa_domains Number of NUMA domains per node.  If > 0, ranks are assumed to be
+//!        bound to domains in contiguous blocks of intranode ranks.  If <= 0, the
+//!        domains are queried from the MPI library, or the node is treated as a single
+//!        domain if it cannot provide them.
+//! \return The domain of each intranode rank, numbered from 0 in order of the lowest
+//!         intranode rank in each domain
+std::vector<int> get_numa_domains(const Comm& intranode_comm, int numa_domains)
+{
+  std::vector<int> domains(intranode_comm.size);
+
+  if (numa_domains > 0) {
+    int d = static_cast<long>(intranode_comm.rank) * numa_domains / intranode_comm.size;
+    intranode_comm.Allgather(&d, 1, MPI_INT, domains.data(), 1, MPI_INT);
+    return domains;
+  }
+
+  MPI_Comm temp_comm = MPI_COMM_NULL;
+#if defined(OPEN_MPI) && OMPI_MAJOR_VERSION >= 2
+  MPI_Comm_split_type(intranode_comm.comm,
+                      OMPI_COMM_TYPE_NUMA,
+                      intranode_comm.rank,
+                      MPI_INFO_NULL,
+                      &temp_comm);
+#elif MPI_VERSION >= 4
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "mpi_hw_resource_type", "NUMANode");
+  MPI_Comm_split_type(
+    intranode_comm.comm, MPI_COMM_TYPE_HW_GUIDED, intranode_comm.rank, info, &temp_comm);
+  MPI_Info_free(&info);
+#endif
+
+  // Each domain is labeled by its lowest intranode rank
+  int label = 0;
+  if (temp_comm != MPI_COMM_NULL) {
+    Comm numa_comm(temp_comm);
+    label = intranode_comm.rank;
+    numa_comm.broadcast(label);
+    numa_comm.free();
+  }
+  intranode_comm.Allgather(&label, 1, MPI_INT, domains.data(), 1, MPI_INT);
+
+  // Number the domains consecutively
+  std::vector<int> labels(domains);
+  std::sort(labels.begin(), labels.end());
+  labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+  for (auto& d : domains) {
+    d = std::lower_bound(labels.cbegin(), labels.cend(), d) - labels.cbegin();
+  }
+  return domains;
+}
+
+//! Decides whether an intranode rank is among the procs-per-node of a driver
+//!
+//! \param domains The NUMA domain of each intranode rank
+//! \param rank The intranode rank
+//! \param ppn The driver's procs-per-node
+//! \param placement How the ranks are chosen
+//! \param from_last For Placement::numa, fill the domains from the last one
+bool is_placed(const std::vector<int>& domains,
+               int rank,
+               int ppn,
+               Placement placement,
+               bool from_last)
+{
+  if (placement == Placement::block) {
+    return rank < ppn;
+  }
+
+  int n_domains = *std::max_element(domains.cbegin(), domains.cend()) + 1;
+  std::vector<int> domain_size(n_domains, 0);
+  for (auto d : domains) {
+    ++domain_size[d];
+  }
+  int domain = domains[rank];
+  auto domain_rank = std::count(domains.cbegin(), domains.cbegin() + rank, domain);
+
+  if (placement == Placement::interleave) {
+    // Deal out the procs round-robin to the domains that still have free ranks
+    std::vector<int> quota(n_domains, 0);
+    int n_ranks = domains.size();
+    for (int i = 0, d = 0; i < ppn && i < n_ranks; d = (d + 1) % n_domains) {
+      if (quota[d] < domain_size[d]) {
+        ++quota[d];
+        ++i;
+      }
+    }
+    return domain_rank < quota[domain];
+  }
+
+  // Placement::numa: fill whole domains, one after another
+  int offset = 0;
+  if (from_last) {
+    for (int d = n_domains - 1; d > domain; --d) {
+      offset += domain_size[d];
+    }
+  } else {
+    for (int d = 0; d < domain; ++d) {
+      offset += domain_size[d];
+    }
+  }
+  return offset + domain_rank < ppn;
+}
+
+} // namespace
+
+void get_driver_comms(Comm super_comm,
+                      std::array<int, 2> num_nodes,
+                      std::array<int, 2> procs_per_node,
+                      std::array<Comm, 2>& driver_comms,
+                      Comm& intranode_comm,
+                      Comm& coupling_comm)
+{
+  get_driver_comms(super_comm,
+                   num_nodes,
+                   procs_per_node,
+                   Placement::block,
+                   0,
+                   driver_comms,
+                   intranode_comm,
+                   coupling_comm);
+}
+
 void get_driver_comms(Comm super_comm,
                       std::array<int, 2> num_nodes,
                       std::array<int, 2> procs_per_node,
+                      Placement placement,
+                      int numa_domains,
                       std::array<Comm, 2>& driver_comms,
                       Comm& intranode_comm,
                       Comm& coupling_comm)
@@ -35,6 +170,12 @@ void get_driver_comms(Comm super_comm,
   int node_idx = coupling_comm.rank;
   intranode_comm.broadcast(node_idx);
 
+  // The NUMA domains are only needed to place ranks within a node
+  std::vector<int> domains;
+  if (placement != Placement::block) {
+    domains = get_numa_domains(intranode_comm, numa_domains);
+  }
+
   // Get the driver comms. driver_comms[0] gets the left-hand nodes, and
   // driver_comms[1] gets the right-hand nodes, both based on the node_idx
   for (const int i : {0, 1}) {
@@ -45,14 +186,18 @@ void get_driver_comms(Comm super_comm,
     auto ppn = procs_per_node[i] > 0 ? procs_per_node[i] : intranode_comm.size;
     auto& scomm = driver_comms[i];
 
+    // Within a node, driver_comms[1] fills NUMA domains from the last one, so the
+    // drivers only share a domain when they need more than half the node
+    bool placed = is_placed(domains, intranode_comm.rank, ppn, placement, i == 1);
+
     int color;
     // Left-hand nodes
     if (i == 0) {
-      color = (node_idx < n && intranode_comm.rank < ppn) ? KEEP : DISCARD;
+      color = (node_idx < n && placed) ? KEEP : DISCARD;
     }
     // Right-hand nodes
     else {
-      color = (node_idx >= total_nodes - n && intranode_comm.rank < ppn) ? KEEP : DISCARD;
+      color = (node_idx >= total_nodes - n && placed) ? KEEP : DISCARD;
     }
     MPI_Comm_split(super_comm.comm, color, super_comm.rank, &temp_comm);
     scomm = Comm(temp_comm);
@@ -62,6 +207,33 @@ void get_driver_comms(Comm super_comm,
   }
 }
 
+std::array<int, 2> balance_nodes(std::array<double, 2> work, int total_nodes)
+{
+  if (total_nodes < 2) {
+    throw std::runtime_error{"Balancing the drivers' nodes requires at least 2 nodes"};
+  }
+  Expects(work[0] >= 0.0 && work[1] >= 0.0);
+
+  // The Picard loop runs the drivers one after another, so with perfect scaling, the
+  // time per iteration is work[0] / n + work[1] / (total_nodes - n).  Its continuous
+  // minimum is at n / (total_nodes - n) = sqrt(work[0] / work[1]).
+  auto time = [&](int n) { return work[0] / n + work[1] / (total_nodes - n); };
+  double r0 = std::sqrt(work[0]);
+  double r1 = std::sqrt(work[1]);
+  double n_opt = r0 + r1 > 0.0 ? total_nodes * r0 / (r0 + r1) : 0.5 * total_nodes;
+
+  int n = 1;
+  double best = std::numeric_limits<double>::max();
+  for (int m : {static_cast<int>(std::floor(n_opt)), static_cast<int>(std::ceil(n_opt))}) {
+    m = std::min(std::max(m, 1), total_nodes - 1);
+    if (time(m) < best) {
+      best = time(m);
+      n = m;
+    }
+  }
+  return {n, total_nodes - n};
+}
+
 std::vector<int> gather_subcomm_ranks(const Comm& super, const Comm& sub)
 {
   std::vector<int> ranks(super.size);
@@ -71,7 +243,7 @@ std::vector<int> gather_subcomm_ranks(const Comm& super, const Comm& sub)
   ranks.erase(new_end, ranks.end());
 
   if (sub.active()) {
-    Ensures(sub.size == ranks.size());
+    Ensures(static_cast<std::size_t>(sub.size) == ranks.size());
   }
   return ranks;
 }
@@ -0,0 +1,242 @@
+#include "enrico/compression.h"
+
+#include <gsl/gsl>
+
+#include <algorithm> // for minmax_element
+#include <cmath>
+#include <cstdint>
+#include <cstring> // for memcpy
+#include <stdexcept>
+
+namespace enrico {
+
+namespace {
+
+// Leading flag byte of the compressed data
+const unsigned char RAW = 0;
+const unsigned char ENCODED = 1;
+
+// Size of the header: flag byte followed by the number of values
+const std::size_t HEADER_SIZE = 1 + sizeof(std::uint64_t);
+
+//! Appends an unsigned integer with 7 bits per byte, low bits first
+void put_varint(std::vector<unsigned char>& bytes, std::uint64_t x)
+{
+  while (x >= 0x80) {
+    bytes.push_back(static_cast<unsigned char>(x | 0x80));
+    x >>= 7;
+  }
+  bytes.push_back(static_cast<unsigned char>(x));
+}
+
+//! Reads an unsigned integer written by put_varint, advancing pos
+std::uint64_t get_varint(const std::vector<unsigned char>& bytes, std::size_t& pos)
+{
+  std::uint64_t x = 0;
+  for (int shift = 0; pos < bytes.size(); shift += 7) {
+    auto b = bytes[pos++];
+    x |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return x;
+    }
+  }
+  throw std::runtime_error{"Truncated compressed coupling data"};
+}
+
+//! The bits of a double
+std::uint64_t to_bits(double x)
+{
+  std::uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(x));
+  return bits;
+}
+
+} // namespace
+
+std::vector<unsigned char>
+compress(const double* values, std::size_t n, const std::vector<double>& reference)
+{
+  const int width = sizeof(std::uint64_t);
+  bool has_ref = reference.size() == n;
+
+  // XOR with the reference, then shuffle: byte plane k holds byte k of every value
+  std::vector<unsigned char> shuffled(n * width);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto bits = to_bits(values[i]) ^ (has_ref ? to_bits(reference[i]) : 0);
+    for (int k = 0; k < width; ++k) {
+      shuffled[k * n + i] = static_cast<unsigned char>(bits >> (8 * k));
+    }
+  }
+
+  std::vector<unsigned char> bytes(HEADER_SIZE);
+  bytes[0] = ENCODED;
+  std::uint64_t n64 = n;
+  std::memcpy(&bytes[1], &n64, sizeof(n64));
+
+  // Run-length encode zero bytes as a zero followed by the run length
+  for (std::size_t i = 0; i < shuffled.size();) {
+    if (shuffled[i] == 0) {
+      std::size_t run = 1;
+      while (i + run < shuffled.size() && shuffled[i + run] == 0) {
+        ++run;
+      }
+      bytes.push_back(0);
+      put_varint(bytes, run);
+      i += run;
+    } else {
+      bytes.push_back(shuffled[i++]);
+    }
+  }
+
+  // Fall back to the raw values if encoding did not help
+  if (bytes.size() >= HEADER_SIZE + n * width) {
+    bytes.resize(HEADER_SIZE + n * width);
+    bytes[0] = RAW;
+    std::memcpy(&bytes[HEADER_SIZE], values, n * width);
+  }
+  return bytes;
+}
+
+std::vector<double> decompress(const std::vector<unsigned char>& bytes,
+                               const std::vector<double>& reference)
+{
+  const int width = sizeof(std::uint64_t);
+  Expects(bytes.size() >= HEADER_SIZE);
+
+  std::uint64_t n64;
+  std::memcpy(&n64, &bytes[1], sizeof(n64));
+  auto n = gsl::narrow_cast<std::size_t>(n64);
+  std::vector<double> values(n);
+
+  if (bytes[0] == RAW) {
+    Expects(bytes.size() == HEADER_SIZE + n * width);
+    std::memcpy(values.data(), &bytes[HEADER_SIZE], n * width);
+    return values;
+  }
+
+  // Undo the run-length encoding
+  std::vector<unsigned char> shuffled;
+  shuffled.reserve(n * width);
+  for (std::size_t pos = HEADER_SIZE; pos < bytes.size();) {
+    auto b = bytes[pos++];
+    if (b == 0) {
+      shuffled.insert(shuffled.end(), get_varint(bytes, pos), 0);
+    } else {
+      shuffled.push_back(b);
+    }
+  }
+  if (shuffled.size() != n * width) {
+    throw std::runtime_error{"Corrupt compressed coupling data"};
+  }
+
+  // Unshuffle and undo the XOR with the reference
+  bool has_ref = reference.size() == n;
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint64_t bits = 0;
+    for (int k = 0; k < width; ++k) {
+      bits |= static_cast<std::uint64_t>(shuffled[k * n + i]) << (8 * k);
+    }
+    bits ^= has_ref ? to_bits(reference[i]) : 0;
+    std::memcpy(&values[i], &bits, sizeof(bits));
+  }
+  return values;
+}
+
+std::vector<unsigned char>
+encode(const double* values, std::size_t n, Precision precision, double& max_error)
+{
+  std::vector<unsigned char> bytes(HEADER_SIZE);
+  bytes[0] = static_cast<unsigned char>(precision);
+  std::uint64_t n64 = n;
+  std::memcpy(&bytes[1], &n64, sizeof(n64));
+
+  // Append a value of any trivial type
+  auto put = [&bytes](const auto& x) {
+    auto p = reinterpret_cast<const unsigned char*>(&x);
+    bytes.insert(bytes.end(), p, p + sizeof(x));
+  };
+
+  max_error = 0.0;
+  switch (precision) {
+  case Precision::full:
+    bytes.resize(HEADER_SIZE + n * sizeof(double));
+    std::memcpy(&bytes[HEADER_SIZE], values, n * sizeof(double));
+    break;
+  case Precision::single:
+    bytes.reserve(HEADER_SIZE + n * sizeof(float));
+    for (std::size_t i = 0; i < n; ++i) {
+      auto x = static_cast<float>(values[i]);
+      max_error = std::max(max_error, std::abs(static_cast<double>(x) - values[i]));
+      put(x);
+    }
+    break;
+  case Precision::fixed: {
+    // Map [min, max] linearly onto the 16-bit integers, rounding to nearest
+    auto minmax = std::minmax_element(values, values + n);
+    double offset = n > 0 ? *minmax.first : 0.0;
+    double range = n > 0 ? *minmax.second - offset : 0.0;
+    double scale = range > 0.0 ? range / UINT16_MAX : 1.0;
+    put(offset);
+    put(scale);
+    bytes.reserve(bytes.size() + n * sizeof(std::uint16_t));
+    for (std::size_t i = 0; i < n; ++i) {
+      auto q = static_cast<std::uint16_t>(std::lround((values[i] - offset) / scale));
+      max_error = std::max(max_error, std::abs(offset + q * scale - values[i]));
+      put(q);
+    }
+    break;
+  }
+  }
+  return bytes;
+}
+
+std::vector<double> decode(const std::vector<unsigned char>& bytes)
+{
+  Expects(bytes.size() >= HEADER_SIZE);
+
+  std::uint64_t n64;
+  std::memcpy(&n64, &bytes[1], sizeof(n64));
+  auto n = gsl::narrow_cast<std::size_t>(n64);
+  std::vector<double> values(n);
+
+  // Read a value of any trivial type, advancing pos
+  std::size_t pos = HEADER_SIZE;
+  auto get = [&bytes, &pos](auto& x) {
+    if (pos + sizeof(x) > bytes.size()) {
+      throw std::runtime_error{"Truncated encoded coupling data"};
+    }
+    std::memcpy(&x, &bytes[pos], sizeof(x));
+    pos += sizeof(x);
+  };
+
+  switch (static_cast<Precision>(bytes[0])) {
+  case Precision::full:
+    for (auto& v : values) {
+      get(v);
+    }
+    break;
+  case Precision::single:
+    for (auto& v : values) {
+      float x;
+      get(x);
+      v = x;
+    }
+    break;
+  case Precision::fixed: {
+    double offset, scale;
+    get(offset);
+    get(scale);
+    for (auto& v : values) {
+      std::uint16_t q;
+      get(q);
+      v = offset + q * scale;
+    }
+    break;
+  }
+  default:
+    throw std::runtime_error{"Invalid precision in encoded coupling data"};
+  }
+  return values;
+}
+
+} // namespace enrico
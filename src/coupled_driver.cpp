@@ -23,6 +23,9 @@
 #include <xtensor/xnorm.hpp>    // for norm_l1, norm_l2, norm_linf
 
 #include <algorithm> // for copy
+#include <cmath>     // for abs
+#include <cstdio>    // for remove
+#include <fstream>
 #include <iomanip>
 #include <map>
 #include <memory> // for make_unique
@@ -39,24 +42,17 @@ namespace enrico {
 
 CoupledDriver::CoupledDriver(MPI_Comm comm, pugi::xml_node node)
   : comm_(comm)
-  , timer_init_comms(comm_)
-  , timer_init_mapping(comm_)
-  , timer_init_tallies(comm_)
-  , timer_init_volume(comm_)
-  , timer_init_fluid_mask(comm_)
-  , timer_init_temperature(comm_)
-  , timer_init_density(comm_)
-  , timer_init_heat_source(comm_)
-  , timer_update_density(comm_)
-  , timer_update_heat_source(comm_)
-  , timer_update_temperature(comm_)
 {
   parse_xml_params(node);
+  if (!trace_file_.empty()) {
+    timers.start_trace(comm_);
+  }
   init_comms(node);
   init_mapping();
   init_tallies();
   init_volume();
   init_fluid_mask();
+  init_shared_memory();
   init_temperature();
   init_density();
   init_heat_source();
@@ -128,88 +124,188 @@ void CoupledDriver::parse_xml_params(const pugi::xml_node& node)
     }
   }
 
+  if (coup_node.child("comm_scheme")) {
+    std::string s = coup_node.child_value("comm_scheme");
+
+    if (s == "flat") {
+      comm_scheme_ = CommScheme::flat;
+    } else if (s == "hierarchical") {
+      comm_scheme_ = CommScheme::hierarchical;
+    } else {
+      throw std::runtime_error{"Invalid value for <comm_scheme>"};
+    }
+  }
+
+  if (coup_node.child("shared_memory")) {
+    shared_memory_ = coup_node.child("shared_memory").text().as_bool();
+  }
+
+  if (coup_node.child("placement")) {
+    std::string s = coup_node.child_value("placement");
+    if (s == "block") {
+      placement_ = Placement::block;
+    } else if (s == "interleave") {
+      placement_ = Placement::interleave;
+    } else if (s == "numa") {
+      placement_ = Placement::numa;
+    } else {
+      throw std::runtime_error{"Invalid value for <placement>"};
+    }
+  }
+  if (coup_node.child("numa_domains")) {
+    numa_domains_ = coup_node.child("numa_domains").text().as_int();
+  }
+  if (coup_node.child("balance_nodes")) {
+    balance_nodes_file_ = coup_node.child_value("balance_nodes");
+  }
+  if (coup_node.child("balance_threads")) {
+    balance_threads_ = coup_node.child("balance_threads").text().as_bool();
+  }
+  if (coup_node.child("compression")) {
+    compression_ = coup_node.child("compression").text().as_bool();
+  }
+  if (coup_node.child("comm_counters")) {
+    comm_counters.enable(coup_node.child("comm_counters").text().as_bool());
+  }
+  if (coup_node.child("hw_counters")) {
+    timers.enable_hw_counters(coup_node.child("hw_counters").text().as_bool());
+  }
+  if (coup_node.child("memory_tracking")) {
+    timers.enable_memory_tracking(coup_node.child("memory_tracking").text().as_bool());
+  }
+  if (coup_node.child("output")) {
+    std::string s = coup_node.child_value("output");
+    if (s == "every") {
+      output_ = Output::every;
+    } else if (s == "converged") {
+      output_ = Output::converged;
+    } else if (s == "final") {
+      output_ = Output::final;
+    } else {
+      throw std::runtime_error{"Invalid value for <output>"};
+    }
+  }
+  if (coup_node.child("output_interval")) {
+    output_interval_ = coup_node.child("output_interval").text().as_int();
+  }
+  if (coup_node.child("output_keep")) {
+    output_keep_ = coup_node.child("output_keep").text().as_int();
+  }
+  if (coup_node.child("trace")) {
+    trace_file_ = coup_node.child_value("trace");
+  }
+  if (coup_node.child("field_precision")) {
+    std::string s = coup_node.child_value("field_precision");
+    if (s == "double") {
+      field_precision_ = Precision::full;
+    } else if (s == "float") {
+      field_precision_ = Precision::single;
+    } else if (s == "fixed") {
+      field_precision_ = Precision::fixed;
+    } else {
+      throw std::runtime_error{"Invalid value for <field_precision>"};
+    }
+  }
+
   Expects(power_ > 0);
   Expects(max_timesteps_ >= 0);
   Expects(max_picard_iter_ >= 0);
   Expects(epsilon_ > 0);
+  Expects(output_interval_ > 0);
+  Expects(output_keep_ >= 0);
 }
 
 void CoupledDriver::init_comms(const pugi::xml_node& node)
 {
-  timer_init_comms.start();
-
   auto neut_node = node.child("neutronics");
   auto heat_node = node.child("heat_fluids");
-
-  // Create communicators
-  std::array<int, 2> nodes{neut_node.child("nodes").text().as_int(),
-                           heat_node.child("nodes").text().as_int()};
-  std::array<int, 2> procs_per_node{neut_node.child("procs_per_node").text().as_int(),
-                                    heat_node.child("procs_per_node").text().as_int()};
   std::array<Comm, 2> driver_comms;
-  Comm intranode_comm; // Not used in current comm scheme
-  Comm coupling_comm;  // Not used in current comm scheme
 
-  get_driver_comms(
-    comm_, nodes, procs_per_node, driver_comms, intranode_comm, coupling_comm);
+  {
+    auto timer = timers.scope("CoupledDriver/init_comms");
+
+    // Create communicators
+    std::array<int, 2> nodes{neut_node.child("nodes").text().as_int(),
+                             heat_node.child("nodes").text().as_int()};
+    std::array<int, 2> procs_per_node{neut_node.child("procs_per_node").text().as_int(),
+                                      heat_node.child("procs_per_node").text().as_int()};
+    if (!balance_nodes_file_.empty()) {
+      nodes = this->balanced_nodes(nodes);
+    }
+
+    get_driver_comms(comm_,
+                     nodes,
+                     procs_per_node,
+                     placement_,
+                     numa_domains_,
+                     driver_comms,
+                     intranode_comm_,
+                     coupling_comm_);
+  }
 
   auto neutronics_comm = driver_comms[0];
   auto heat_comm = driver_comms[1];
 
-  timer_init_comms.stop();
+  {
+    auto timer = timers.scope("NeutronicsDriver");
 
-  // Instantiate neutronics driver
-  std::string neut_driver = neut_node.child_value("driver");
-  if (neut_driver == "openmc") {
-    neutronics_driver_ = std::make_unique<OpenmcDriver>(neutronics_comm.comm);
-  } else if (neut_driver == "shift") {
+    // Instantiate neutronics driver
+    std::string neut_driver = neut_node.child_value("driver");
+    if (neut_driver == "openmc") {
+      neutronics_driver_ = std::make_unique<OpenmcDriver>(neutronics_comm.comm, neut_node);
+    } else if (neut_driver == "shift") {
 #ifdef USE_SHIFT
-    neutronics_driver_ = std::make_unique<ShiftDriver>(comm, neut_node);
+      neutronics_driver_ = std::make_unique<ShiftDriver>(comm, neut_node);
 #else
-    throw std::runtime_error{"ENRICO has not been built with Shift support enabled."};
+      throw std::runtime_error{"ENRICO has not been built with Shift support enabled."};
 #endif
-  } else {
-    throw std::runtime_error{"Invalid value for <neutronics><driver>"};
+    } else {
+      throw std::runtime_error{"Invalid value for <neutronics><driver>"};
+    }
   }
 
-  // Instantiate heat-fluids driver
-  std::string s = heat_node.child_value("driver");
-  if (s == "nek5000") {
+  {
+    auto timer = timers.scope("HeatFluidsDriver");
+
+    // Instantiate heat-fluids driver
+    std::string s = heat_node.child_value("driver");
+    if (s == "nek5000") {
 #ifdef USE_NEK5000
-    heat_fluids_driver_ = std::make_unique<Nek5000Driver>(heat_comm.comm, heat_node);
+      heat_fluids_driver_ = std::make_unique<Nek5000Driver>(heat_comm.comm, heat_node);
 #else
-    throw std::runtime_error{
-      "nek5000 was specified as a solver, but is not enabled in this build of ENRICO"};
+      throw std::runtime_error{
+        "nek5000 was specified as a solver, but is not enabled in this build of ENRICO"};
 #endif
-  } else if (s == "nekrs") {
+    } else if (s == "nekrs") {
 #ifdef USE_NEKRS
-    heat_fluids_driver_ = std::make_unique<NekRSDriver>(heat_comm.comm, heat_node);
+      heat_fluids_driver_ = std::make_unique<NekRSDriver>(heat_comm.comm, heat_node);
 #else
-    throw std::runtime_error{
-      "nekrs was specified as a solver, but is not enabled in this build of ENRICO"};
+      throw std::runtime_error{
+        "nekrs was specified as a solver, but is not enabled in this build of ENRICO"};
 #endif
-  } else if (s == "surrogate") {
-    heat_fluids_driver_ =
-      std::make_unique<SurrogateHeatDriver>(heat_comm.comm, heat_node);
-  } else {
-    throw std::runtime_error{"Invalid value for <heat_fluids><driver>"};
+    } else if (s == "surrogate") {
+      heat_fluids_driver_ =
+        std::make_unique<SurrogateHeatDriver>(heat_comm.comm, heat_node);
+    } else {
+      throw std::runtime_error{"Invalid value for <heat_fluids><driver>"};
+    }
   }
 
-  timer_init_comms.start();
-
-  // Discover the rank IDs (relative to comm_) that are in each single-physics subcomm
-  neutronics_ranks_ = gather_subcomm_ranks(comm_, neutronics_comm);
-  heat_ranks_ = gather_subcomm_ranks(comm_, heat_comm);
+  {
+    auto timer = timers.scope("CoupledDriver/init_comms");
 
-  // Send rank ID of neutronics subcomm root (relative to comm_) to all procs
-  neutronics_root_ = this->get_neutronics_driver().comm_.is_root() ? comm_.rank : -1;
-  MPI_Allreduce(MPI_IN_PLACE, &neutronics_root_, 1, MPI_INT, MPI_MAX, comm_.comm);
+    // Discover the rank IDs (relative to comm_) that are in each single-physics subcomm
+    neutronics_ranks_ = gather_subcomm_ranks(comm_, neutronics_comm);
+    heat_ranks_ = gather_subcomm_ranks(comm_, heat_comm);
 
-  // Send rank ID of heat subcomm root (relative to comm_) to all procs
-  heat_root_ = this->get_heat_driver().comm_.is_root() ? comm_.rank : -1;
-  MPI_Allreduce(MPI_IN_PLACE, &heat_root_, 1, MPI_INT, MPI_MAX, comm_.comm);
+    // Send rank ID of neutronics subcomm root (relative to comm_) to all procs
+    neutronics_root_ = this->get_neutronics_driver().comm_.is_root() ? comm_.rank : -1;
+    comm_.allreduce(neutronics_root_, MPI_MAX);
 
-  timer_init_comms.stop();
+    // Send rank ID of heat subcomm root (relative to comm_) to all procs
+    heat_root_ = this->get_heat_driver().comm_.is_root() ? comm_.rank : -1;
+    comm_.allreduce(heat_root_, MPI_MAX);
+  }
 
   comm_report();
 }
@@ -229,6 +325,8 @@ void CoupledDriver::execute()
     for (i_picard_ = 0; i_picard_ < max_picard_iter_; ++i_picard_) {
       std::string msg = "i_picard: " + std::to_string(i_picard_);
       comm_.message(msg);
+      auto iteration = timers.trace("i_timestep " + std::to_string(i_timestep_) +
+                                    ", i_picard " + std::to_string(i_picard_));
 
       if (neutronics.active()) {
 #ifdef _OPENMP
@@ -240,10 +338,9 @@ void CoupledDriver::execute()
           neutronics.comm_.message(msg);
         }
 #endif
+        auto timer = timers.scope("NeutronicsDriver");
         neutronics.init_step();
         neutronics.solve_step();
-        neutronics.write_step(i_timestep_, i_picard_);
-        neutronics.finalize_step();
       }
 
       comm_.Barrier();
@@ -253,6 +350,17 @@ void CoupledDriver::execute()
       // so we can't apply underrelaxation at that point
       update_heat_source(i_timestep_ > 0 || i_picard_ > 0);
 
+      // The neutronics output is written once the heat source has been sent, so that
+      // it overlaps the heat-fluids solve on ranks that only run neutronics.  Its state
+      // is kept until the next init_step, so output can also wait for convergence.
+      if (neutronics.active()) {
+        auto timer = timers.scope("NeutronicsDriver");
+        if (output_ == Output::every && output_due(false)) {
+          write_output(neutronics, neutronics_output_);
+        }
+        neutronics.finalize_step();
+      }
+
       if (heat.active()) {
 #ifdef _OPENMP
         omp_set_num_threads(heat.num_threads);
@@ -263,9 +371,12 @@ void CoupledDriver::execute()
           heat.comm_.message(msg);
         }
 #endif
+        auto timer = timers.scope("HeatFluidsDriver");
         heat.init_step();
         heat.solve_step();
-        heat.write_step(i_timestep_, i_picard_);
+        if (output_ == Output::every && output_due(false)) {
+          write_output(heat, heat_output_);
+        }
         heat.finalize_step();
       }
 
@@ -279,17 +390,100 @@ void CoupledDriver::execute()
       update_density(true);
 
       timer_report();
+      precision_report();
 
-      if (is_converged()) {
+      bool converged = is_converged();
+      if (output_ != Output::every && output_due(converged)) {
+        if (neutronics.active()) {
+          auto timer = timers.scope("NeutronicsDriver");
+          write_output(neutronics, neutronics_output_);
+        }
+        if (heat.active()) {
+          auto timer = timers.scope("HeatFluidsDriver");
+          write_output(heat, heat_output_);
+        }
+      }
+
+      if (converged) {
         std::string msg = "converged at i_picard = " + std::to_string(i_picard_);
         comm_.message(msg);
         break;
       }
     }
     comm_.Barrier();
+
+    if (balance_threads_) {
+      balance_threads();
+    }
   }
   // TODO: Is this final heat.write_step still needed?
-  heat.write_step();
+  {
+    auto timer = timers.scope("HeatFluidsDriver");
+    heat.write_step();
+  }
+
+  if (!trace_file_.empty()) {
+    comm_.message("Writing trace file: " + trace_file_);
+    timers.write_trace(trace_file_, comm_);
+  }
+}
+
+void CoupledDriver::balance_threads()
+{
+  auto& neutronics = get_neutronics_driver();
+  auto& heat = get_heat_driver();
+
+  if (rank_cores_ == 0) {
+    rank_cores_ = std::max(neutronics.active() ? neutronics.num_threads : 0,
+                           heat.active() ? heat.num_threads : 0);
+  }
+
+  // Each driver's solve time in the last timestep; inactive drivers report 0
+  std::array<double, 2> solve_time{timers.elapsed("NeutronicsDriver/solve_step"),
+                                   timers.elapsed("HeatFluidsDriver/solve_step")};
+  std::vector<double> step_time{solve_time[0] - solve_time_prev_[0],
+                                solve_time[1] - solve_time_prev_[1]};
+  solve_time_prev_ = solve_time;
+  intranode_comm_.allreduce(step_time, MPI_MAX);
+
+  // Count the ranks and cores of each driver on this node
+  std::vector<int> counts{neutronics.active() ? 1 : 0,
+                          heat.active() ? 1 : 0,
+                          neutronics.active() && heat.active() ? 1 : 0,
+                          rank_cores_};
+  intranode_comm_.allreduce(counts, MPI_SUM);
+  int n_neut = counts[0];
+  int n_heat = counts[1];
+  int n_both = counts[2];
+  int n_cores = counts[3];
+
+  // Ranks that run both drivers already use all their cores in each phase
+  if (n_neut == 0 || n_heat == 0 || n_both > 0 || n_cores < 2) {
+    return;
+  }
+
+  // The drivers run one after another, so the cores are split the same way as nodes
+  // are split by balance_nodes(): in proportion to the square root of each driver's
+  // core-seconds.  Every rank on the node holds the same threads for each driver.
+  std::vector<int> threads{neutronics.active() ? neutronics.num_threads : 0,
+                           heat.active() ? heat.num_threads : 0};
+  intranode_comm_.allreduce(threads, MPI_MAX);
+  std::array<double, 2> work{step_time[0] * n_neut * threads[0],
+                             step_time[1] * n_heat * threads[1]};
+  auto cores = balance_nodes(work, n_cores);
+
+  if (neutronics.active()) {
+    neutronics.num_threads = std::max(1, cores[0] / n_neut);
+  }
+  if (heat.active()) {
+    heat.num_threads = std::max(1, cores[1] / n_heat);
+  }
+
+  // Nodes are rebalanced independently, so only report the root's node
+  std::stringstream msg;
+  msg << "Rebalanced OpenMP threads per rank: " << std::max(1, cores[0] / n_neut)
+      << " for neutronics, " << std::max(1, cores[1] / n_heat) << " for heat-fluids";
+  comm_.message(msg.str());
 }
 
 double CoupledDriver::temperature_norm(Norm norm)
@@ -301,19 +495,19 @@ double CoupledDriver::temperature_norm(Norm norm)
   if (heat.active()) {
     switch (norm) {
     case Norm::L1: {
-      double local_norm = xt::norm_l1(cell_temperature_ - cell_temperature_prev_)();
-      MPI_Reduce(&local_norm, &global_norm, 1, MPI_DOUBLE, MPI_SUM, 0, heat.comm_.comm);
+      global_norm = xt::norm_l1(cell_temperature_ - cell_temperature_prev_)();
+      heat.comm_.reduce(global_norm, MPI_SUM);
       break;
     }
     case Norm::L2: {
-      double local_norm = xt::norm_sq(cell_temperature_ - cell_temperature_prev_)();
-      MPI_Reduce(&local_norm, &global_norm, 1, MPI_DOUBLE, MPI_SUM, 0, heat.comm_.comm);
+      global_norm = xt::norm_sq(cell_temperature_ - cell_temperature_prev_)();
+      heat.comm_.reduce(global_norm, MPI_SUM);
       global_norm = std::sqrt(global_norm);
       break;
     }
     case Norm::LINF: {
-      double local_norm = xt::norm_linf(cell_temperature_ - cell_temperature_prev_)();
-      MPI_Reduce(&local_norm, &global_norm, 1, MPI_DOUBLE, MPI_MAX, 0, heat.comm_.comm);
+      global_norm = xt::norm_linf(cell_temperature_ - cell_temperature_prev_)();
+      heat.comm_.reduce(global_norm, MPI_MAX);
       break;
     }
     }
@@ -322,6 +516,38 @@ double CoupledDriver::temperature_norm(Norm norm)
   return global_norm;
 }
 
+bool CoupledDriver::output_due(bool converged) const
+{
+  switch (output_) {
+  case Output::every:
+    return (i_picard_ + 1) % output_interval_ == 0;
+  case Output::converged:
+    return converged;
+  case Output::final:
+    return converged || i_picard_ + 1 == max_picard_iter_;
+  }
+  return false;
+}
+
+void CoupledDriver::write_output(Driver& driver, std::deque<std::array<int, 2>>& written)
+{
+  driver.write_step(i_timestep_, i_picard_);
+  if (output_keep_ == 0) {
+    return;
+  }
+
+  written.push_back({i_timestep_, i_picard_});
+  if (written.size() > static_cast<std::size_t>(output_keep_)) {
+    auto oldest = written.front();
+    written.pop_front();
+    if (driver.comm_.is_root()) {
+      for (const auto& f : driver.output_files(oldest[0], oldest[1])) {
+        std::remove(f.c_str());
+      }
+    }
+  }
+}
+
 bool CoupledDriver::is_converged()
 {
   bool converged;
@@ -339,17 +565,24 @@ bool CoupledDriver::is_converged()
   std::stringstream msg;
   msg << "temperature norm: " << norm;
   comm_.message(msg.str());
+
+  this->get_neutronics_driver().set_temperature_norm(norm);
   return converged;
 }
 
 void CoupledDriver::update_heat_source(bool relax)
 {
   comm_.message("Updating heat source");
-  timer_update_heat_source.start();
+  auto timer = timers.scope("CoupledDriver/update_heat_source");
 
   auto& neutronics = this->get_neutronics_driver();
   auto& heat = this->get_heat_driver();
 
+  if (neutronics.heat_basis()) {
+    update_basis_heat_source(relax);
+    return;
+  }
+
   if (relax && heat.active()) {
     std::copy(
       cell_heat_source_.cbegin(), cell_heat_source_.cend(),
@@ -361,25 +594,40 @@ void CoupledDriver::update_heat_source(bool relax)
   xt::xtensor<double, 1> all_cell_heat;
 
   // For the coupling scheme, only the neutronics root needs the heat source.
-  // However, to compute the heat source, OpenmcDriver::heat_source must
+  // However, to normalize the heat source, OpenmcDriver::heat_source must
   // do a collective operation on all the ranks in the neutronics sub comm.
-  // Hence, all neutronics ranks must call OpenmcDriver::heat_source
+  // Hence, all neutronics ranks must call OpenmcDriver::heat_source, though
+  // only the root gets the full array back.
   if (neutronics.active()) {
     all_cell_heat = neutronics.heat_source(power_);
   }
 
   // The neutronics root sends the cell-averaged heat sources to the heat ranks.
   // Each heat rank gets only the heat sources for its local cells.
-  for (const auto& heat_rank : heat_ranks_) {
-    comm_.send_and_recv(cells_recv, neutronics_root_, cell_to_glob_cell_, heat_rank);
-    cell_heat_send.resize({cells_recv.size()});
-    if (comm_.rank == neutronics_root_) {
-      for (gsl::index i = 0; i < cells_recv.size(); ++i) {
-        auto j = neutronics.cell_index(cells_recv.at(i));
-        cell_heat_send.at(i) = all_cell_heat.at(j);
+  if (comm_scheme_ == CommScheme::hierarchical) {
+    hierarchical_scatter(all_cell_heat);
+  } else {
+    for (gsl::index r = 0; r < heat_ranks_.size(); ++r) {
+      recv_from_heat_rank(cells_recv, cell_to_glob_cell_, node_cells_, r);
+      cell_heat_send.resize({cells_recv.size()});
+      if (comm_.rank == neutronics_root_) {
+        for (gsl::index i = 0; i < cells_recv.size(); ++i) {
+          auto j = neutronics.cell_index(cells_recv.at(i));
+          cell_heat_send.at(i) = all_cell_heat.at(j);
+        }
       }
+      send_to_heat_rank(
+        cell_heat_source_, cell_heat_send, node_field_, r, heat_source_transport_);
     }
-    comm_.send_and_recv(cell_heat_source_, heat_rank, cell_heat_send, neutronics_root_);
+
+    // Heat ranks that share the neutronics root's node read from shared memory.  No
+    // rank may overwrite the buffer until they have done so.
+    node_field_.sync();
+    if (shares_neutronics_node_) {
+      std::copy_n(
+        node_field_.local_data(), node_field_.local_size(), cell_heat_source_.begin());
+    }
+    node_field_.sync();
   }
 
   // On heat rank, update the elements' heat sources based on the cell-avged heat sources
@@ -398,13 +646,73 @@ void CoupledDriver::update_heat_source(bool relax)
       }
     }
   }
-  timer_update_heat_source.stop();
+}
+
+void CoupledDriver::update_basis_heat_source(bool relax)
+{
+  auto& neutronics = this->get_neutronics_driver();
+  auto& heat = this->get_heat_driver();
+
+  if (relax && heat.active()) {
+    std::copy(elem_heat_source_.cbegin(),
+              elem_heat_source_.cend(),
+              elem_heat_source_prev_.begin());
+  }
+
+  // The basis is independent of the heat ranks' decomposition, so every rank gets all
+  // of its values rather than the neutronics root sending each heat rank its own part
+  xt::xtensor<double, 1> basis_heat;
+  if (neutronics.active()) {
+    basis_heat = neutronics.heat_source(power_);
+  }
+  comm_.broadcast(basis_heat, neutronics_root_);
+
+  // The power mapped to the elements should match the power in the basis, unless
+  // elements are outside it or resolve it too coarsely
+  double mapped_power = 0.0;
+  if (heat.active()) {
+    for (gsl::index e = 0; e < elem_heat_source_.size(); ++e) {
+      double q = 0.0;
+      for (auto j = elem_basis_offset_[e]; j < elem_basis_offset_[e + 1]; ++j) {
+        q += elem_basis_weight_[j] * basis_heat(elem_basis_index_[j]);
+      }
+      elem_heat_source_(e) = q;
+      mapped_power += q * elem_volume_[e];
+    }
+  }
+  comm_.reduce(mapped_power, MPI_SUM);
+  if (comm_.is_root()) {
+    const auto* basis = neutronics.heat_basis();
+    double basis_power = basis->integral(basis_heat);
+    if (std::abs(mapped_power - basis_power) > BASIS_POWER_TOLERANCE * basis_power) {
+      std::stringstream msg;
+      msg << "WARNING: Heat source mapped to heat/fluids elements is " << mapped_power
+          << " W, but the heat source tallied in " << basis->region() << " is "
+          << basis_power << " W";
+      comm_.message(msg.str());
+    }
+  }
+
+  if (heat.active()) {
+    if (relax) {
+      if (alpha_ == ROBBINS_MONRO) {
+        int n = i_picard_ + 1;
+        elem_heat_source_ = elem_heat_source_ / n + (1. - 1. / n) * elem_heat_source_prev_;
+      } else {
+        elem_heat_source_ =
+          alpha_ * elem_heat_source_ + (1.0 - alpha_) * elem_heat_source_prev_;
+      }
+    }
+    for (gsl::index e = 0; e < elem_heat_source_.size(); ++e) {
+      heat.set_heat_source_at(e, elem_heat_source_(e));
+    }
+  }
 }
 
 void CoupledDriver::update_temperature(bool relax)
 {
   comm_.message("Updating temperature");
-  timer_update_temperature.start();
+  auto timer = timers.scope("CoupledDriver/update_temperature");
 
   auto& neutronics = this->get_neutronics_driver();
   auto& heat = this->get_heat_driver();
@@ -444,21 +752,51 @@ void CoupledDriver::update_temperature(bool relax)
     }
   }
 
+  // With the hierarchical scheme, the cell-avged T is accumulated on the neutronics root
+  if (comm_scheme_ == CommScheme::hierarchical) {
+    auto T = hierarchical_average(cell_temperature_, false);
+    for (gsl::index i = 0; i < coupled_cells_.size(); ++i) {
+      neutronics.set_temperature(coupled_cells_[i], T[i]);
+    }
+    return;
+  }
+
   // Step 3: On each neutron rank, accumulate cell-avged volumes from all heat ranks
   std::unordered_map<CellHandle, double> T_dot_V;
   std::unordered_map<CellHandle, double> cell_V;
   decltype(cell_to_glob_cell_) cells_recv;
   decltype(cell_volume_) cell_volumes_recv;
   decltype(cell_temperature_) cell_temperatures_recv;
-  for (const auto& heat_rank : heat_ranks_) {
-    comm_.send_and_recv(cells_recv, neutronics_root_, cell_to_glob_cell_, heat_rank);
+  std::vector<CellRecord> records_recv;
+
+  // Heat ranks that share the neutronics root's node write T to shared memory
+  if (shares_neutronics_node_) {
+    std::copy(
+      cell_temperature_.cbegin(), cell_temperature_.cend(), node_field_.local_data());
+  }
+  node_field_.sync();
+
+  for (gsl::index r = 0; r < heat_ranks_.size(); ++r) {
+    if (sends_cell_records(r)) {
+      recv_cell_records(records_recv, cell_temperature_, r);
+      neutronics.comm_.broadcast(records_recv);
+      if (neutronics.active()) {
+        for (const auto& record : records_recv) {
+          cell_V[record.cell] += record.volume;
+          T_dot_V[record.cell] += record.value * record.volume;
+        }
+      }
+      continue;
+    }
+
+    recv_from_heat_rank(cells_recv, cell_to_glob_cell_, node_cells_, r);
     neutronics.comm_.broadcast(cells_recv);
 
-    comm_.send_and_recv(
-      cell_temperatures_recv, neutronics_root_, cell_temperature_, heat_rank);
+    recv_from_heat_rank(
+      cell_temperatures_recv, cell_temperature_, node_field_, r, temperature_transport_);
     neutronics.comm_.broadcast(cell_temperatures_recv);
 
-    comm_.send_and_recv(cell_volumes_recv, neutronics_root_, cell_volume_, heat_rank);
+    recv_from_heat_rank(cell_volumes_recv, cell_volume_, node_volume_, r);
     neutronics.comm_.broadcast(cell_volumes_recv);
 
     if (neutronics.active()) {
@@ -470,18 +808,20 @@ void CoupledDriver::update_temperature(bool relax)
       }
     }
   }
+  // No rank may overwrite the buffer until the neutronics root has read it
+  node_field_.sync();
+
   for (const auto& kv : T_dot_V) {
     auto cell = kv.first;
     auto tv = kv.second;
     neutronics.set_temperature(cell, tv / cell_V.at(cell));
   }
-  timer_update_temperature.stop();
 }
 
 void CoupledDriver::update_density(bool relax)
 {
   comm_.message("Updating density");
-  timer_update_density.start();
+  auto timer = timers.scope("CoupledDriver/update_density");
 
   auto& neutronics = this->get_neutronics_driver();
   auto& heat = this->get_heat_driver();
@@ -519,6 +859,17 @@ void CoupledDriver::update_density(bool relax)
     }
   }
 
+  // With the hierarchical scheme, the cell-avged rho is accumulated on the neutronics root
+  if (comm_scheme_ == CommScheme::hierarchical) {
+    auto rho = hierarchical_average(cell_density_, true);
+    for (gsl::index i = 0; i < coupled_cells_.size(); ++i) {
+      if (coupled_cell_fluid_mask_[i] == 1) {
+        neutronics.set_density(coupled_cells_[i], rho[i]);
+      }
+    }
+    return;
+  }
+
   // Step 3: On each neutron rank, accumulate cell-avged volumes from all heat ranks
   std::map<CellHandle, double> rho_dot_V;
   std::map<CellHandle, double> cell_V;
@@ -526,20 +877,40 @@ void CoupledDriver::update_density(bool relax)
   decltype(cell_volume_) cell_volumes_recv;
   decltype(cell_density_) cell_densities_recv;
   decltype(cell_fluid_mask_) cell_fluid_mask_recv;
+  std::vector<CellRecord> records_recv;
 
-  for (const auto& heat_rank : heat_ranks_) {
-    comm_.send_and_recv(cells_recv, neutronics_root_, cell_to_glob_cell_, heat_rank);
+  // Heat ranks that share the neutronics root's node write rho to shared memory
+  if (shares_neutronics_node_) {
+    std::copy(cell_density_.cbegin(), cell_density_.cend(), node_field_.local_data());
+  }
+  node_field_.sync();
+
+  for (gsl::index r = 0; r < heat_ranks_.size(); ++r) {
+    if (sends_cell_records(r)) {
+      recv_cell_records(records_recv, cell_density_, r);
+      neutronics.comm_.broadcast(records_recv);
+      if (neutronics.active()) {
+        for (const auto& record : records_recv) {
+          if (record.fluid == 1) {
+            cell_V[record.cell] += record.volume;
+            rho_dot_V[record.cell] += record.value * record.volume;
+          }
+        }
+      }
+      continue;
+    }
+
+    recv_from_heat_rank(cells_recv, cell_to_glob_cell_, node_cells_, r);
     neutronics.comm_.broadcast(cells_recv);
 
-    comm_.send_and_recv(cell_volumes_recv, neutronics_root_, cell_volume_, heat_rank);
+    recv_from_heat_rank(cell_volumes_recv, cell_volume_, node_volume_, r);
     neutronics.comm_.broadcast(cell_volumes_recv);
 
-    comm_.send_and_recv(
-      cell_densities_recv, neutronics_root_, cell_density_, heat_rank);
+    recv_from_heat_rank(
+      cell_densities_recv, cell_density_, node_field_, r, density_transport_);
     neutronics.comm_.broadcast(cell_densities_recv);
 
-    comm_.send_and_recv(
-      cell_fluid_mask_recv, neutronics_root_, cell_fluid_mask_, heat_rank);
+    recv_from_heat_rank(cell_fluid_mask_recv, cell_fluid_mask_, node_fluid_mask_, r);
     neutronics.comm_.broadcast(cell_fluid_mask_recv);
 
     if (neutronics.active()) {
@@ -554,16 +925,68 @@ void CoupledDriver::update_density(bool relax)
     }
   }
 
+  // No rank may overwrite the buffer until the neutronics root has read it
+  node_field_.sync();
+
   for (const auto& kv : rho_dot_V) {
     neutronics.set_density(kv.first, kv.second / cell_V.at(kv.first));
   }
-  timer_update_density.stop();
+}
+
+std::array<int, 2> CoupledDriver::balanced_nodes(std::array<int, 2> nodes) const
+{
+  // The total number of nodes is the number of intranode roots
+  MPI_Comm temp_comm;
+  MPI_Comm_split_type(
+    comm_.comm, MPI_COMM_TYPE_SHARED, comm_.rank, MPI_INFO_NULL, &temp_comm);
+  Comm node_comm(temp_comm);
+  int total_nodes = node_comm.is_root() ? 1 : 0;
+  comm_.allreduce(total_nodes, MPI_SUM);
+  node_comm.free();
+
+  // The root reads the solve times, in the cumulative times last reported by the
+  // previous run, and converts them to node-seconds
+  std::array<double, 2> work{-1.0, -1.0};
+  if (comm_.is_root()) {
+    std::ifstream is{balance_nodes_file_};
+    auto neut_times = TimeAmt::read_times(is, "NeutronicsDriver");
+    is.clear();
+    is.seekg(0);
+    auto heat_times = TimeAmt::read_times(is, "HeatFluidsDriver");
+
+    auto solve_time = [](const std::vector<TimeAmt>& times) {
+      for (const auto& t : times) {
+        if (t.name == "solve_step") {
+          return t.time;
+        }
+      }
+      return -1.0;
+    };
+    work = {solve_time(neut_times), solve_time(heat_times)};
+    for (const int i : {0, 1}) {
+      if (work[i] >= 0.0) {
+        work[i] *= nodes[i] > 0 ? nodes[i] : total_nodes;
+      }
+    }
+  }
+  comm_.Bcast(work.data(), 2, MPI_DOUBLE);
+  if (work[0] < 0.0 || work[1] < 0.0) {
+    throw std::runtime_error{"Could not read the solve times of both drivers from " +
+                             balance_nodes_file_};
+  }
+
+  auto balanced = balance_nodes(work, total_nodes);
+  std::stringstream msg;
+  msg << "Balanced nodes from " << balance_nodes_file_ << ": " << balanced[0]
+      << " for neutronics, " << balanced[1] << " for heat-fluids";
+  comm_.message(msg.str());
+  return balanced;
 }
 
 void CoupledDriver::init_mapping()
 {
   comm_.message("Initializing mappings");
-  timer_init_mapping.start();
+  auto timer = timers.scope("CoupledDriver/init_mapping");
 
   const auto& heat = this->get_heat_driver();
   auto& neutronics = this->get_neutronics_driver();
@@ -609,26 +1032,53 @@ void CoupledDriver::init_mapping()
     for (const auto& kv : glob_cell_to_elem_) {
       cell_to_glob_cell_.push_back(kv.first);
     }
+
+    // With a heat source given in a basis, elements are also mapped directly to the
+    // basis values at their centroids
+    if (const auto* basis = neutronics.heat_basis()) {
+      elem_basis_offset_.push_back(0);
+      for (const auto& r : heat.centroid()) {
+        basis->weights(r, elem_basis_index_, elem_basis_weight_);
+        elem_basis_offset_.push_back(elem_basis_index_.size());
+      }
+    }
+  }
+
+  // Elements whose centroids are outside the basis get no heat source
+  if (const auto* basis = neutronics.heat_basis()) {
+    std::vector<long> n_elem{0, 0};
+    for (std::size_t e = 0; e + 1 < elem_basis_offset_.size(); ++e) {
+      ++n_elem[0];
+      if (elem_basis_offset_[e + 1] == elem_basis_offset_[e]) {
+        ++n_elem[1];
+      }
+    }
+    comm_.reduce(n_elem, MPI_SUM);
+    if (n_elem[1] > 0) {
+      std::stringstream msg;
+      msg << "WARNING: " << n_elem[1] << " of " << n_elem[0]
+          << " heat/fluids elements have centroids outside " << basis->region()
+          << " and get no heat source";
+      comm_.message(msg.str());
+    }
   }
-  timer_init_mapping.stop();
 }
 
 void CoupledDriver::init_tallies()
 {
   comm_.message("Initializing tallies");
-  timer_init_tallies.start();
+  auto timer = timers.scope("CoupledDriver/init_tallies");
 
   auto& neutronics = this->get_neutronics_driver();
   if (neutronics.active()) {
     neutronics.create_tallies();
   }
-  timer_init_tallies.stop();
 }
 
 void CoupledDriver::init_temperature()
 {
   comm_.message("Initializing temperatures");
-  timer_init_temperature.start();
+  auto timer = timers.scope("CoupledDriver/init_temperature");
 
   const auto& neutronics = this->get_neutronics_driver();
   const auto& heat = this->get_heat_driver();
@@ -668,28 +1118,27 @@ void CoupledDriver::init_temperature()
     std::copy(cell_temperature_.begin(),
               cell_temperature_.end(), cell_temperature_prev_.begin());
   }
-  timer_init_temperature.stop();
 }
 
 void CoupledDriver::init_volume()
 {
   comm_.message("Initializing volumes");
-  timer_init_volume.start();
-
   const auto& heat = this->get_heat_driver();
   const auto& neutronics = this->get_neutronics_driver();
 
-  if (heat.active()) {
-    elem_volume_ = heat.volume();
-    for (const auto& c : cell_to_glob_cell_) {
-      double V = 0.0;
-      for (const auto& e : glob_cell_to_elem_.at(c)) {
-        V += elem_volume_.at(e);
+  {
+    auto timer = timers.scope("CoupledDriver/init_volume");
+    if (heat.active()) {
+      elem_volume_ = heat.volume();
+      for (const auto& c : cell_to_glob_cell_) {
+        double V = 0.0;
+        for (const auto& e : glob_cell_to_elem_.at(c)) {
+          V += elem_volume_.at(e);
+        }
+        cell_volume_.push_back(V);
       }
-      cell_volume_.push_back(V);
     }
   }
-  timer_init_volume.stop();
 
   check_volumes();
 }
@@ -765,7 +1214,7 @@ void CoupledDriver::check_volumes()
 void CoupledDriver::init_density()
 {
   comm_.message("Initializing densities");
-  timer_init_density.start();
+  auto timer = timers.scope("CoupledDriver/init_density");
 
   const auto& neutronics = this->get_neutronics_driver();
   const auto& heat = this->get_heat_driver();
@@ -801,13 +1250,12 @@ void CoupledDriver::init_density()
   if (heat.active()) {
     std::copy(cell_density_.cbegin(), cell_density_.cend(), cell_density_prev_.begin());
   }
-  timer_init_density.stop();
 }
 
 void CoupledDriver::init_fluid_mask()
 {
   comm_.message("Initializing cell fluid mask");
-  timer_init_fluid_mask.start();
+  auto timer = timers.scope("CoupledDriver/init_fluid_mask");
 
   auto& heat = this->get_heat_driver();
 
@@ -826,20 +1274,376 @@ void CoupledDriver::init_fluid_mask()
       cell_fluid_mask_.push_back(in_fluid);
     }
   }
-  timer_init_fluid_mask.stop();
+}
+
+void CoupledDriver::init_shared_memory()
+{
+  if (comm_scheme_ == CommScheme::flat && !shared_memory_) {
+    return;
+  }
+
+  comm_.message("Initializing shared-memory communication");
+  auto timer = timers.scope("CoupledDriver/init_comms");
+
+  const auto& heat = this->get_heat_driver();
+
+  // Each heat rank puts its local cells in shared memory, so every node's cells
+  // are contiguous and in intranode rank order
+  std::size_t n_local = heat.active() ? cell_to_glob_cell_.size() : 0;
+  node_cells_ = SharedWindow<CellHandle>(intranode_comm_, n_local);
+  node_volume_ = SharedWindow<double>(intranode_comm_, n_local);
+  node_fluid_mask_ = SharedWindow<int>(intranode_comm_, n_local);
+  node_field_ = SharedWindow<double>(intranode_comm_, n_local);
+  if (heat.active()) {
+    std::copy(
+      cell_to_glob_cell_.cbegin(), cell_to_glob_cell_.cend(), node_cells_.local_data());
+    std::copy(cell_volume_.cbegin(), cell_volume_.cend(), node_volume_.local_data());
+    std::copy(
+      cell_fluid_mask_.cbegin(), cell_fluid_mask_.cend(), node_fluid_mask_.local_data());
+  }
+  node_cells_.sync();
+  node_volume_.sync();
+  node_fluid_mask_.sync();
+
+  if (comm_scheme_ == CommScheme::hierarchical) {
+    init_hierarchical();
+  } else {
+    // The neutronics root finds which heat ranks share its node.  Each node
+    // discovers the ranks (wrt comm_) of its ranks, in intranode rank order.
+    std::vector<int> node_ranks(intranode_comm_.size);
+    intranode_comm_.Allgather(
+      &comm_.rank, 1, MPI_INT, node_ranks.data(), 1, MPI_INT);
+    heat_rank_segment_.assign(heat_ranks_.size(), -1);
+    if (comm_.rank == neutronics_root_) {
+      for (gsl::index i = 0; i < heat_ranks_.size(); ++i) {
+        auto it = std::find(node_ranks.cbegin(), node_ranks.cend(), heat_ranks_[i]);
+        if (it != node_ranks.cend()) {
+          heat_rank_segment_[i] = it - node_ranks.cbegin();
+        }
+      }
+    }
+    comm_.broadcast(heat_rank_segment_, neutronics_root_);
+
+    auto it = std::find(heat_ranks_.cbegin(), heat_ranks_.cend(), comm_.rank);
+    shares_neutronics_node_ =
+      it != heat_ranks_.cend() && heat_rank_segment_[it - heat_ranks_.cbegin()] >= 0;
+  }
+}
+
+void CoupledDriver::init_hierarchical()
+{
+  auto& neutronics = this->get_neutronics_driver();
+
+  // The node leaders send to the neutronics root over coupling_comm_, so the root
+  // must also lead its node.  Send its rank in coupling_comm_ to all procs.
+  coupling_neutronics_root_ =
+    (comm_.rank == neutronics_root_ && coupling_comm_.active()) ? coupling_comm_.rank
+                                                                : -1;
+  comm_.allreduce(coupling_neutronics_root_, MPI_MAX);
+  if (coupling_neutronics_root_ < 0) {
+    throw std::runtime_error{
+      "The hierarchical comm scheme requires the neutronics root to be a node root"};
+  }
+
+  // The neutronics root receives the cells from each node root that has any
+  std::vector<CellHandle> entry_cells;
+  for (int leader = 0; leader < coupling_comm_.size; ++leader) {
+    std::vector<CellHandle> cells_send;
+    std::vector<double> volumes_send;
+    std::vector<int> fluid_mask_send;
+    if (coupling_comm_.rank == leader) {
+      auto n = node_cells_.size();
+      cells_send.assign(node_cells_.data(), node_cells_.data() + n);
+      volumes_send.assign(node_volume_.data(), node_volume_.data() + n);
+      fluid_mask_send.assign(node_fluid_mask_.data(), node_fluid_mask_.data() + n);
+    }
+
+    std::vector<CellHandle> cells_recv;
+    std::vector<double> volumes_recv;
+    std::vector<int> fluid_mask_recv;
+    coupling_comm_.send_and_recv(
+      cells_recv, coupling_neutronics_root_, cells_send, leader);
+    coupling_comm_.send_and_recv(
+      volumes_recv, coupling_neutronics_root_, volumes_send, leader);
+    coupling_comm_.send_and_recv(
+      fluid_mask_recv, coupling_neutronics_root_, fluid_mask_send, leader);
+
+    if (comm_.rank == neutronics_root_ && !cells_recv.empty()) {
+      heat_leaders_.push_back(leader);
+      heat_leader_offsets_.push_back(entry_cells.size());
+      entry_cells.insert(entry_cells.end(), cells_recv.cbegin(), cells_recv.cend());
+      entry_volume_.insert(
+        entry_volume_.end(), volumes_recv.cbegin(), volumes_recv.cend());
+      entry_fluid_mask_.insert(
+        entry_fluid_mask_.end(), fluid_mask_recv.cbegin(), fluid_mask_recv.cend());
+    }
+  }
+
+  // The neutronics root finds the unique coupled cells, which may be split among
+  // several heat ranks, and accumulates their volumes
+  if (comm_.rank == neutronics_root_) {
+    heat_leader_offsets_.push_back(entry_cells.size());
+    std::map<CellHandle, gsl::index> cell_index;
+    for (gsl::index i = 0; i < entry_cells.size(); ++i) {
+      auto it = cell_index.find(entry_cells[i]);
+      if (it == cell_index.end()) {
+        it = cell_index.emplace(entry_cells[i], coupled_cells_.size()).first;
+        coupled_cells_.push_back(entry_cells[i]);
+        coupled_cell_fluid_mask_.push_back(entry_fluid_mask_[i]);
+        coupled_cell_volume_.push_back(0.0);
+      }
+      entry_to_coupled_cell_.push_back(it->second);
+      coupled_cell_volume_[it->second] += entry_volume_[i];
+    }
+  }
+
+  // Every neutronics rank sets temperatures and densities, so every one needs the cells
+  neutronics.comm_.broadcast(coupled_cells_);
+  neutronics.comm_.broadcast(coupled_cell_fluid_mask_);
+
+  // Every field exchange between the node roots and the neutronics root has the same
+  // buffers and counts, so set up persistent requests for them once
+  if (comm_.rank == neutronics_root_) {
+    entry_field_.resize(entry_cells.size());
+    for (gsl::index i = 0; i < heat_leaders_.size(); ++i) {
+      auto offset = heat_leader_offsets_[i];
+      auto n = heat_leader_offsets_[i + 1] - offset;
+      field_gather_.add(coupling_comm_.send_and_recv_init<double>(
+        entry_field_.data() + offset, coupling_comm_.rank, nullptr, heat_leaders_[i], n));
+      field_scatter_.add(coupling_comm_.send_and_recv_init<double>(
+        nullptr, heat_leaders_[i], entry_field_.data() + offset, coupling_comm_.rank, n));
+    }
+  } else if (coupling_comm_.active() && node_field_.size() > 0) {
+    auto n = node_field_.size();
+    field_gather_.add(coupling_comm_.send_and_recv_init<double>(
+      nullptr, coupling_neutronics_root_, node_field_.data(), coupling_comm_.rank, n));
+    field_scatter_.add(coupling_comm_.send_and_recv_init<double>(
+      node_field_.data(), coupling_comm_.rank, nullptr, coupling_neutronics_root_, n));
+  }
+}
+
+template<typename T, typename Buffer>
+void CoupledDriver::recv_from_heat_rank(Buffer& recvbuf,
+                                        Buffer& sendbuf,
+                                        const SharedWindow<T>& window,
+                                        gsl::index i)
+{
+  int segment = heat_rank_segment_.empty() ? -1 : heat_rank_segment_[i];
+  if (segment < 0) {
+    comm_.send_and_recv_probed(recvbuf, neutronics_root_, sendbuf, heat_ranks_[i]);
+  } else if (comm_.rank == neutronics_root_) {
+    // The heat rank shares the root's node, so read its segment directly
+    auto n = window.segment_size(segment);
+    recvbuf.resize({n});
+    std::copy_n(window.data() + window.segment_offset(segment), n, recvbuf.begin());
+  }
+}
+
+template<typename T, typename Buffer>
+void CoupledDriver::send_to_heat_rank(Buffer& recvbuf,
+                                      Buffer& sendbuf,
+                                      SharedWindow<T>& window,
+                                      gsl::index i)
+{
+  int segment = heat_rank_segment_.empty() ? -1 : heat_rank_segment_[i];
+  if (segment < 0) {
+    // The heat rank already knows the shape of its local field
+    comm_.send_and_recv(
+      recvbuf, heat_ranks_[i], sendbuf, neutronics_root_, recvbuf.shape());
+  } else if (comm_.rank == neutronics_root_) {
+    // The heat rank shares the root's node, so write its segment directly.  It reads
+    // the segment after the next sync of the window.
+    Expects(sendbuf.size() == window.segment_size(segment));
+    std::copy(
+      sendbuf.cbegin(), sendbuf.cend(), window.data() + window.segment_offset(segment));
+  }
+}
+
+void CoupledDriver::recv_from_heat_rank(xt::xtensor<double, 1>& recvbuf,
+                                        xt::xtensor<double, 1>& sendbuf,
+                                        const SharedWindow<double>& window,
+                                        gsl::index i,
+                                        FieldTransport& transport)
+{
+  int segment = heat_rank_segment_.empty() ? -1 : heat_rank_segment_[i];
+  if (segment >= 0) {
+    recv_from_heat_rank(recvbuf, sendbuf, window, i);
+  } else if (field_precision_ != Precision::full) {
+    comm_.send_and_recv_encoded(recvbuf,
+                                neutronics_root_,
+                                sendbuf,
+                                heat_ranks_[i],
+                                field_precision_,
+                                transport.max_error);
+  } else if (compression_) {
+    transport.references.resize(heat_ranks_.size());
+    comm_.send_and_recv_compressed(
+      recvbuf, neutronics_root_, sendbuf, heat_ranks_[i], transport.references[i]);
+  } else {
+    recv_from_heat_rank(recvbuf, sendbuf, window, i);
+  }
+}
+
+bool CoupledDriver::sends_cell_records(gsl::index i) const
+{
+  int segment = heat_rank_segment_.empty() ? -1 : heat_rank_segment_[i];
+  return segment < 0 && field_precision_ == Precision::full && !compression_;
+}
+
+void CoupledDriver::recv_cell_records(std::vector<CellRecord>& recvbuf,
+                                      const xt::xtensor<double, 1>& field,
+                                      gsl::index i)
+{
+  std::vector<CellRecord> sendbuf;
+  if (comm_.rank == heat_ranks_[i]) {
+    sendbuf.resize(cell_to_glob_cell_.size());
+    for (gsl::index j = 0; j < sendbuf.size(); ++j) {
+      sendbuf[j].cell = cell_to_glob_cell_[j];
+      sendbuf[j].value = field(j);
+      sendbuf[j].volume = cell_volume_[j];
+      sendbuf[j].fluid = cell_fluid_mask_.empty() ? 0 : cell_fluid_mask_[j];
+    }
+  }
+  comm_.send_and_recv_probed(recvbuf, neutronics_root_, sendbuf, heat_ranks_[i]);
+}
+
+void CoupledDriver::send_to_heat_rank(xt::xtensor<double, 1>& recvbuf,
+                                      xt::xtensor<double, 1>& sendbuf,
+                                      SharedWindow<double>& window,
+                                      gsl::index i,
+                                      FieldTransport& transport)
+{
+  int segment = heat_rank_segment_.empty() ? -1 : heat_rank_segment_[i];
+  if (segment >= 0) {
+    send_to_heat_rank(recvbuf, sendbuf, window, i);
+  } else if (field_precision_ != Precision::full) {
+    comm_.send_and_recv_encoded(recvbuf,
+                                heat_ranks_[i],
+                                sendbuf,
+                                neutronics_root_,
+                                field_precision_,
+                                transport.max_error);
+  } else if (compression_) {
+    transport.references.resize(heat_ranks_.size());
+    comm_.send_and_recv_compressed(
+      recvbuf, heat_ranks_[i], sendbuf, neutronics_root_, transport.references[i]);
+  } else {
+    send_to_heat_rank(recvbuf, sendbuf, window, i);
+  }
+}
+
+void CoupledDriver::precision_report()
+{
+  if (field_precision_ == Precision::full) {
+    return;
+  }
+
+  std::vector<double> errors{temperature_transport_.max_error,
+                             density_transport_.max_error,
+                             heat_source_transport_.max_error};
+  comm_.reduce(errors, MPI_MAX);
+  temperature_transport_.max_error = 0.0;
+  density_transport_.max_error = 0.0;
+  heat_source_transport_.max_error = 0.0;
+
+  std::stringstream msg;
+  msg << "Largest errors from reduced-precision transport: temperature "
+      << std::scientific << std::setprecision(4) << errors[0] << ", density "
+      << errors[1] << ", heat source " << errors[2];
+  comm_.message(msg.str());
+}
+
+std::vector<double>
+CoupledDriver::hierarchical_average(const xt::xtensor<double, 1>& local_values,
+                                    bool fluid_only)
+{
+  auto& neutronics = this->get_neutronics_driver();
+
+  // Each heat rank writes its local values to its segment of the node's buffer
+  if (this->get_heat_driver().active()) {
+    std::copy(local_values.cbegin(), local_values.cend(), node_field_.local_data());
+  }
+  node_field_.sync();
+
+  // Each node root sends its node's buffer to the neutronics root in one message
+  field_gather_.start();
+  for (gsl::index i = 0; i < heat_leaders_.size(); ++i) {
+    if (heat_leaders_[i] == coupling_comm_.rank) {
+      auto offset = heat_leader_offsets_[i];
+      auto n = heat_leader_offsets_[i + 1] - offset;
+      std::copy_n(node_field_.data(), n, entry_field_.begin() + offset);
+    }
+  }
+  field_gather_.wait();
+
+  // No rank may overwrite the buffer until its node root has sent it
+  node_field_.sync();
+
+  // The neutronics root volume-averages the values of each coupled cell
+  std::vector<double> values;
+  if (comm_.rank == neutronics_root_) {
+    values.assign(coupled_cells_.size(), 0.0);
+    for (gsl::index i = 0; i < entry_field_.size(); ++i) {
+      if (!fluid_only || entry_fluid_mask_[i] == 1) {
+        values[entry_to_coupled_cell_[i]] += entry_field_[i] * entry_volume_[i];
+      }
+    }
+    for (gsl::index i = 0; i < values.size(); ++i) {
+      values[i] /= coupled_cell_volume_[i];
+    }
+  }
+  neutronics.comm_.broadcast(values);
+  return values;
+}
+
+void CoupledDriver::hierarchical_scatter(const xt::xtensor<double, 1>& all_cell_heat)
+{
+  auto& neutronics = this->get_neutronics_driver();
+
+  // The neutronics root sends each node root the heat sources for its node's buffer
+  if (comm_.rank == neutronics_root_) {
+    for (gsl::index i = 0; i < entry_field_.size(); ++i) {
+      auto j = neutronics.cell_index(coupled_cells_[entry_to_coupled_cell_[i]]);
+      entry_field_[i] = all_cell_heat.at(j);
+    }
+  }
+  field_scatter_.start();
+  for (gsl::index i = 0; i < heat_leaders_.size(); ++i) {
+    if (heat_leaders_[i] == coupling_comm_.rank) {
+      auto offset = heat_leader_offsets_[i];
+      auto n = heat_leader_offsets_[i + 1] - offset;
+      std::copy_n(entry_field_.cbegin() + offset, n, node_field_.data());
+    }
+  }
+  field_scatter_.wait();
+  node_field_.sync();
+
+  // Each heat rank reads the heat sources for its local cells from the node's buffer
+  if (this->get_heat_driver().active()) {
+    std::copy_n(node_field_.local_data(),
+                node_field_.local_size(),
+                cell_heat_source_.begin());
+  }
+
+  // No rank may overwrite the buffer until every rank on its node has read it
+  node_field_.sync();
 }
 
 void CoupledDriver::init_heat_source()
 {
   comm_.message("Initializing heat source");
-  timer_init_heat_source.start();
+  auto timer = timers.scope("CoupledDriver/init_heat_source");
 
   if (this->heat_fluids_driver_->active()) {
     auto sz = {cell_to_glob_cell_.size()};
     cell_heat_source_ = xt::empty<double>(sz);
     cell_heat_source_prev_ = xt::empty<double>(sz);
+    if (this->neutronics_driver_->heat_basis()) {
+      auto n_elem = {elem_basis_offset_.size() - 1};
+      elem_heat_source_ = xt::empty<double>(n_elem);
+      elem_heat_source_prev_ = xt::empty<double>(n_elem);
+    }
   }
-  timer_init_heat_source.stop();
 }
 
 void CoupledDriver::comm_report()
@@ -878,34 +1682,9 @@ void CoupledDriver::comm_report()
 
 void CoupledDriver::timer_report()
 {
-
-  auto& heat = this->get_heat_driver();
-  auto& neut = this->get_neutronics_driver();
-
-  std::vector<TimeAmt> coup_times{
-    {"init_comms", timer_init_comms.elapsed()},
-    {"init_fluid_mask", timer_init_fluid_mask.elapsed()},
-    {"init_density", timer_init_density.elapsed()},
-    {"init_heat_source", timer_init_heat_source.elapsed()},
-    {"init_mapping", timer_init_mapping.elapsed()},
-    {"init_tallies", timer_init_tallies.elapsed()},
-    {"init_temperature", timer_init_temperature.elapsed()},
-    {"init_volume", timer_init_volume.elapsed()},
-    {"update_density", timer_update_density.elapsed()},
-    {"update_heat_source", timer_update_heat_source.elapsed()},
-    {"update_temperature", timer_update_temperature.elapsed()}};
-
-  std::vector<TimeAmt> heat_times{{"driver_setup", heat.timer_driver_setup.elapsed()},
-                                  {"init_step", heat.timer_init_step.elapsed()},
-                                  {"solve_step", heat.timer_solve_step.elapsed()},
-                                  {"write_step", heat.timer_write_step.elapsed()},
-                                  {"finalize_step", heat.timer_finalize_step.elapsed()}};
-
-  std::vector<TimeAmt> neut_times{{"driver_setup", neut.timer_driver_setup.elapsed()},
-                                  {"init_step", neut.timer_init_step.elapsed()},
-                                  {"solve_step", neut.timer_solve_step.elapsed()},
-                                  {"write_step", neut.timer_write_step.elapsed()},
-                                  {"finalize_step", neut.timer_finalize_step.elapsed()}};
+  auto coup_times = timers.aggregate("CoupledDriver", comm_);
+  auto neut_times = timers.aggregate("NeutronicsDriver", comm_);
+  auto heat_times = timers.aggregate("HeatFluidsDriver", comm_);
 
   auto tot_time = TimeAmt::sum_times(coup_times) + TimeAmt::sum_times(heat_times) +
                   TimeAmt::sum_times(neut_times);
@@ -926,6 +1705,20 @@ void CoupledDriver::timer_report()
                  TimeAmt::sum_percent(neut_times);
   std::vector<TimeAmt> total_time{{"total", tot_time, tot_pct}};
   TimeAmt::print_times("Total", total_time, comm_);
+
+  TimeAmt::print_imbalance("CoupledDriver", coup_times, comm_);
+  TimeAmt::print_imbalance("NeutronicsDriver", neut_times, comm_);
+  TimeAmt::print_imbalance("HeatFluidsDriver", heat_times, comm_);
+
+  if (comm_counters.enabled()) {
+    comm_counters.report(comm_);
+  }
+  if (timers.hw_counters_enabled()) {
+    timers.hw_report(comm_);
+  }
+  if (timers.memory_tracking_enabled()) {
+    timers.memory_report(comm_);
+  }
 }
 
 } // namespace enrico
@@ -0,0 +1,144 @@
+#include "enrico/hw_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <array>
+
+namespace enrico {
+
+#ifdef __linux__
+
+namespace {
+
+//! The events counted, in the order of the members of HwCounts
+constexpr std::array<std::uint64_t, 4> events{PERF_COUNT_HW_CPU_CYCLES,
+                                               PERF_COUNT_HW_INSTRUCTIONS,
+                                               PERF_COUNT_HW_CACHE_MISSES,
+                                               PERF_COUNT_HW_BRANCH_MISSES};
+
+//! A group of counters of the calling thread, which the kernel schedules together
+class CounterGroup {
+public:
+  CounterGroup()
+  {
+    // Count threads that the calling thread starts, e.g. OpenMP threads, unless the
+    // kernel does not allow it
+    open(true);
+    if (leader_ < 0) {
+      open(false);
+    }
+    if (leader_ < 0) {
+      return;
+    }
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  ~CounterGroup()
+  {
+    for (std::size_t i = 0; i < n_open_; ++i) {
+      close(fds_[i]);
+    }
+  }
+
+  CounterGroup(const CounterGroup&) = delete;
+  CounterGroup& operator=(const CounterGroup&) = delete;
+
+  bool read(HwCounts& counts) const
+  {
+    if (leader_ < 0) {
+      return false;
+    }
+
+    // Inherited counters cannot be read as a group, so each is read on its own.  Its
+    // value includes the counts of the threads that inherited it.
+    std::array<std::uint64_t, events.size()> values{};
+    for (std::size_t i = 0; i < n_open_; ++i) {
+      if (::read(fds_[i], &values[index_[i]], sizeof(std::uint64_t)) < 0) {
+        return false;
+      }
+    }
+    counts = {values[0], values[1], values[2], values[3]};
+    return true;
+  }
+
+  //! Whether the counters include threads started by the thread that opened them
+  bool inherited() const { return inherit_; }
+
+private:
+  //! Open the events that the processor and kernel support
+  //! \param inherit Whether threads started after this call are counted too
+  void open(bool inherit)
+  {
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = events[i];
+      attr.disabled = leader_ < 0 ? 1 : 0;
+      attr.inherit = inherit ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader_, 0);
+      if (fd < 0) {
+        // Without cycles there is no group to add the other events to
+        if (i == 0) {
+          return;
+        }
+        continue;
+      }
+      if (leader_ < 0) {
+        leader_ = fd;
+      }
+      fds_[n_open_] = fd;
+      index_[n_open_++] = i;
+    }
+    inherit_ = inherit;
+  }
+
+  bool inherit_ = false;                           //!< Whether threads are counted
+  int leader_ = -1;                                //!< File descriptor of the leader
+  std::array<int, events.size()> fds_{};           //!< Descriptors of open events
+  std::array<std::size_t, events.size()> index_{}; //!< Event of each descriptor
+  std::size_t n_open_ = 0;                         //!< Number of open events
+};
+
+//! The counters of the calling thread, opened the first time they are used
+const CounterGroup& thread_counters()
+{
+  thread_local CounterGroup group;
+  return group;
+}
+
+} // namespace
+
+bool read_hw_counters(HwCounts& counts)
+{
+  return thread_counters().read(counts);
+}
+
+bool hw_counters_inherited()
+{
+  return thread_counters().inherited();
+}
+
+#else
+
+bool read_hw_counters(HwCounts& counts)
+{
+  return false;
+}
+
+bool hw_counters_inherited()
+{
+  return false;
+}
+
+#endif
+
+} // namespace enrico
@@ -0,0 +1,170 @@
+#include "enrico/memory.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+#ifdef ENRICO_COUNT_ALLOCATIONS
+#include <malloc.h> // for malloc_usable_size
+#endif
+
+namespace enrico {
+
+bool read_memory_usage(MemoryUsage& usage)
+{
+  std::ifstream status{"/proc/self/status"};
+  if (!status) {
+    return false;
+  }
+
+  // Sizes are given in kB, e.g. "VmRSS:     123456 kB"
+  MemoryUsage result;
+  int found = 0;
+  std::string line;
+  while (found < 2 && std::getline(status, line)) {
+    std::istringstream fields{line};
+    std::string key;
+    std::size_t kb;
+    if (!(fields >> key >> kb)) {
+      continue;
+    }
+    if (key == "VmRSS:") {
+      result.rss = kb * 1024;
+      ++found;
+    } else if (key == "VmHWM:") {
+      result.hwm = kb * 1024;
+      ++found;
+    }
+  }
+  if (found < 2) {
+    return false;
+  }
+  usage = result;
+  return true;
+}
+
+#ifdef ENRICO_COUNT_ALLOCATIONS
+
+namespace {
+
+// Counts of the calling thread.  They are trivially initialized, so they can be used
+// from operator new before anything else is constructed.
+thread_local std::size_t n_allocated = 0;
+thread_local std::size_t n_freed = 0;
+thread_local std::size_t n_allocations = 0;
+
+void* counted_malloc(std::size_t size) noexcept
+{
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p) {
+    n_allocated += malloc_usable_size(p);
+    ++n_allocations;
+  }
+  return p;
+}
+
+void* counted_new(std::size_t size)
+{
+  void* p;
+  while (!(p = counted_malloc(size))) {
+    auto handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc{};
+    }
+    handler();
+  }
+  return p;
+}
+
+void counted_free(void* p) noexcept
+{
+  if (p) {
+    n_freed += malloc_usable_size(p);
+    std::free(p);
+  }
+}
+
+} // namespace
+
+bool allocations_counted()
+{
+  return true;
+}
+
+AllocationCounts thread_allocations()
+{
+  return {n_allocated, n_freed, n_allocations};
+}
+
+} // namespace enrico
+
+// Replacements of the global allocation functions, which count the usable size of each
+// block so that frees match allocations exactly
+
+void* operator new(std::size_t size)
+{
+  return enrico::counted_new(size);
+}
+
+void* operator new[](std::size_t size)
+{
+  return enrico::counted_new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return enrico::counted_malloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return enrico::counted_malloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  enrico::counted_free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  enrico::counted_free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  enrico::counted_free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  enrico::counted_free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  enrico::counted_free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  enrico::counted_free(p);
+}
+
+#else
+
+bool allocations_counted()
+{
+  return false;
+}
+
+AllocationCounts thread_allocations()
+{
+  return {};
+}
+
+} // namespace enrico
+
+#endif
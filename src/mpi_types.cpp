@@ -4,6 +4,10 @@
 
 #include <mpi.h>
 
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
 namespace enrico {
 
 //==============================================================================
@@ -12,35 +16,73 @@ namespace enrico {
 
 MPI_Datatype position_mpi_datatype{MPI_DATATYPE_NULL};
 
+namespace {
+
+//! Datatypes of record types, which are freed in free_mpi_datatypes()
+std::unordered_map<std::type_index, MPI_Datatype>& registered_types()
+{
+  static std::unordered_map<std::type_index, MPI_Datatype> types;
+  return types;
+}
+
+//! Strided datatypes, keyed by their base type, count, blocklength, and stride
+std::map<std::tuple<MPI_Datatype, int, int, int>, MPI_Datatype>& strided_types()
+{
+  static std::map<std::tuple<MPI_Datatype, int, int, int>, MPI_Datatype> types;
+  return types;
+}
+
+} // namespace
+
 //==============================================================================
 // Functions
 //==============================================================================
 
 void init_mpi_datatypes()
 {
-  Position p;
-  int blockcounts[3] = {1, 1, 1};
-  MPI_Datatype types[3] = {MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE};
-  MPI_Aint displs[3];
+  position_mpi_datatype = get_mpi_type<Position>();
+}
 
-  // Get displacements of struct members
-  MPI_Get_address(&p.x, &displs[0]);
-  MPI_Get_address(&p.y, &displs[1]);
-  MPI_Get_address(&p.z, &displs[2]);
+void free_mpi_datatypes()
+{
+  for (auto& kv : registered_types()) {
+    MPI_Type_free(&kv.second);
+  }
+  registered_types().clear();
+  for (auto& kv : strided_types()) {
+    MPI_Type_free(&kv.second);
+  }
+  strided_types().clear();
+  position_mpi_datatype = MPI_DATATYPE_NULL;
+}
 
-  // Make the displacements relative
-  displs[2] -= displs[0];
-  displs[1] -= displs[0];
-  displs[0] = 0;
+void register_mpi_datatype(std::type_index key, MPI_Datatype type)
+{
+  registered_types()[key] = type;
+}
 
-  // Make datatype
-  MPI_Type_create_struct(3, blockcounts, displs, types, &position_mpi_datatype);
-  MPI_Type_commit(&position_mpi_datatype);
+MPI_Datatype find_mpi_datatype(std::type_index key)
+{
+  auto it = registered_types().find(key);
+  return it != registered_types().end() ? it->second : MPI_DATATYPE_NULL;
 }
 
-void free_mpi_datatypes()
+MPI_Datatype get_mpi_strided_type(MPI_Datatype type,
+                                  int count,
+                                  int blocklength,
+                                  int stride)
 {
-  MPI_Type_free(&position_mpi_datatype);
+  auto key = std::make_tuple(type, count, blocklength, stride);
+  auto it = strided_types().find(key);
+  if (it != strided_types().end()) {
+    return it->second;
+  }
+
+  MPI_Datatype strided;
+  MPI_Type_vector(count, blocklength, stride, type, &strided);
+  MPI_Type_commit(&strided);
+  strided_types().emplace(key, strided);
+  return strided;
 }
 
 // Traits for mapping plain types to corresponding MPI types (ints)
@@ -50,6 +92,11 @@ MPI_Datatype get_mpi_type<char>()
   return MPI_CHAR;
 }
 template<>
+MPI_Datatype get_mpi_type<unsigned char>()
+{
+  return MPI_UNSIGNED_CHAR;
+}
+template<>
 MPI_Datatype get_mpi_type<short>()
 {
   return MPI_SHORT;
@@ -103,11 +150,4 @@ MPI_Datatype get_mpi_type<bool>()
   return MPI_CXX_BOOL;
 }
 
-// Traits for mapping plain types to corresponding MPI types (user defined)
-template<>
-MPI_Datatype get_mpi_type<Position>()
-{
-  return position_mpi_datatype;
-}
-
 } // namespace enrico
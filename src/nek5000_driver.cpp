@@ -17,7 +17,7 @@ namespace enrico {
 Nek5000Driver::Nek5000Driver(MPI_Comm comm, pugi::xml_node node)
   : HeatFluidsDriver(comm, node)
 {
-  timer_driver_setup.start();
+  auto timer = timers.scope("driver_setup");
   if (active()) {
     casename_ = node.child_value("casename");
     if (node.child("output_heat_source")) {
@@ -47,7 +47,6 @@ Nek5000Driver::Nek5000Driver(MPI_Comm comm, pugi::xml_node node)
     }
   }
   MPI_Barrier(MPI_COMM_WORLD);
-  timer_driver_setup.stop();
 }
 
 void Nek5000Driver::init_session_name()
@@ -100,10 +99,9 @@ std::vector<double> Nek5000Driver::density() const
 
 void Nek5000Driver::solve_step()
 {
-  timer_solve_step.start();
+  auto timer = timers.scope("solve_step");
   nek_reset_counters();
   C2F_nek_solve();
-  timer_solve_step.stop();
 }
 
 Position Nek5000Driver::centroid_at(int32_t local_elem) const
@@ -16,7 +16,7 @@ namespace enrico {
 NekRSDriver::NekRSDriver(MPI_Comm comm, pugi::xml_node node)
   : HeatFluidsDriver(comm, node)
 {
-  timer_driver_setup.start();
+  auto timer = timers.scope("driver_setup");
   if (active()) {
     // Force NEKRS_HOME
     std::stringstream msg;
@@ -88,20 +88,18 @@ NekRSDriver::NekRSDriver(MPI_Comm comm, pugi::xml_node node)
   num_threads = omp_get_num_threads();
 #endif
 
-  timer_driver_setup.stop();
 }
 
 void NekRSDriver::init_step()
 {
-  timer_init_step.start();
+  auto timer = timers.scope("init_step");
   auto min = std::min_element(localq_->cbegin(), localq_->cend());
   auto max = std::max_element(localq_->cbegin(), localq_->cend());
-  timer_init_step.stop();
 }
 
 void NekRSDriver::solve_step()
 {
-  timer_solve_step.start();
+  auto timer = timers.scope("solve_step");
   const int runtime_stat_freq = 500;
   auto elapsed_time = MPI_Wtime();
   tstep_ = 0;
@@ -142,12 +140,11 @@ void NekRSDriver::solve_step()
 
   // TODO:  Do we need this in v20.0 of nekRS?
   nekrs::copyToNek(time_, tstep_);
-  timer_solve_step.stop();
 }
 
 void NekRSDriver::write_step(int timestep, int iteration)
 {
-  timer_write_step.start();
+  auto timer = timers.scope("write_step");
   nekrs::outfld(time_);
   if (output_heat_source_) {
     comm_.message("Writing heat source to .fld file");
@@ -155,7 +152,6 @@ void NekRSDriver::write_step(int timestep, int iteration)
       occa::cpu::wrapMemory(host_, localq_->data(), localq_->size() * sizeof(double));
     writeFld("qsc", time_, 1, 0, &nrs_ptr_->o_U, &nrs_ptr_->o_P, &o_localq, 1);
   }
-  timer_write_step.stop();
 }
 
 Position NekRSDriver::centroid_at(int32_t local_elem) const
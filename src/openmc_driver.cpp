@@ -1,34 +1,127 @@
 #include "enrico/openmc_driver.h"
 
-#include "enrico/const.h"
 #include "enrico/error.h"
 
 #include "openmc/capi.h"
 #include "openmc/cell.h"
 #include "openmc/constants.h"
+#include "openmc/eigenvalue.h"
+#include "openmc/mesh.h"
+#include "openmc/settings.h"
+#include "openmc/simulation.h"
+#include "openmc/source.h"
 #include "openmc/summary.h"
 #include "openmc/tallies/filter.h"
 #include "openmc/tallies/filter_material.h"
+#include "openmc/tallies/filter_mesh.h"
+#include "openmc/tallies/filter_spatial_legendre.h"
+#include "openmc/tallies/filter_zernike.h"
 #include "openmc/tallies/tally.h"
+#include "openmc/xml_interface.h"
 #include "xtensor/xadapt.hpp"
 #include "xtensor/xarray.hpp"
+#include "xtensor/xbuilder.hpp"
 #include "xtensor/xview.hpp"
 #include <gsl/gsl>
 
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <unordered_map>
 
 namespace enrico {
 
-OpenmcDriver::OpenmcDriver(MPI_Comm comm)
+OpenmcDriver::OpenmcDriver(MPI_Comm comm, pugi::xml_node node)
   : NeutronicsDriver(comm)
+  , carry_norm_(std::numeric_limits<double>::infinity())
+  , temperature_norm_(std::numeric_limits<double>::infinity())
 {
-  timer_driver_setup.start();
+  auto timer = timers.scope("driver_setup");
+  if (node.child("warm_rerun")) {
+    warm_rerun_ = node.child("warm_rerun").text().as_bool();
+  }
+  if (node.child("source_carryover")) {
+    carry_source_ = node.child("source_carryover").text().as_bool();
+  }
+  if (node.child("carryover_inactive")) {
+    carry_inactive_ = node.child("carryover_inactive").text().as_int();
+  }
+  if (node.child("carryover_norm")) {
+    carry_norm_ = node.child("carryover_norm").text().as_double();
+  }
+  if (node.child("heating_score")) {
+    heating_score_ = node.child("heating_score").text().as_string();
+    if (heating_score_ != "kappa-fission" && heating_score_ != "heating" &&
+        heating_score_ != "heating-local" && heating_score_ != "fission-q-recoverable") {
+      throw std::runtime_error{"Invalid value for <heating_score>: " + heating_score_};
+    }
+  }
+  if (node.child("photon_transport")) {
+    photon_transport_ = node.child("photon_transport").text().as_bool();
+  }
+  if (photon_transport_ && heating_score_ != "heating") {
+    // Only the heating score counts energy deposited by photons, and heating-local
+    // already deposits the photon energy at neutron collisions, so it would be counted
+    // twice
+    throw std::runtime_error{"<photon_transport> requires the heating score"};
+  }
+  if (node.child("heat_mesh")) {
+    auto mesh_node = node.child("heat_mesh");
+    auto ll = openmc::get_node_array<double>(mesh_node, "lower_left");
+    auto ur = openmc::get_node_array<double>(mesh_node, "upper_right");
+    auto dim = openmc::get_node_array<int>(mesh_node, "dimension");
+    if (ll.size() != 3 || ur.size() != 3 || dim.size() != 3) {
+      throw std::runtime_error{"<heat_mesh> must have three values in each of "
+                               "<lower_left>, <upper_right>, and <dimension>"};
+    }
+    heat_mesh_ =
+      std::make_unique<RegularMesh>(Position{ll[0], ll[1], ll[2]},
+                                    Position{ur[0], ur[1], ur[2]},
+                                    std::array<int, 3>{dim[0], dim[1], dim[2]});
+  }
+  if (node.child("heat_expansion")) {
+    if (heat_mesh_) {
+      throw std::runtime_error{
+        "Only one of <heat_mesh> and <heat_expansion> may be given"};
+    }
+    auto exp_node = node.child("heat_expansion");
+    auto xy = openmc::get_node_array<double>(exp_node, "centers");
+    if (xy.empty() || xy.size() % 2 != 0) {
+      throw std::runtime_error{"<centers> must hold an (x, y) pair for each pin"};
+    }
+    std::vector<std::array<double, 2>> centers;
+    for (std::size_t i = 0; i < xy.size(); i += 2) {
+      centers.push_back({xy[i], xy[i + 1]});
+    }
+    heat_expansion_ =
+      std::make_unique<PinExpansion>(std::move(centers),
+                                     exp_node.child("radius").text().as_double(),
+                                     exp_node.child("z_min").text().as_double(),
+                                     exp_node.child("z_max").text().as_double(),
+                                     exp_node.child("zernike_order").text().as_int(),
+                                     exp_node.child("legendre_order").text().as_int());
+  }
   if (active()) {
+    // Photon data are loaded in openmc_init, so photon transport must be turned on
+    // before it.  A <photon_transport> in settings.xml still takes precedence.
+    if (photon_transport_) {
+      openmc::settings::photon_transport = true;
+    }
     err_chk(openmc_init(0, nullptr, &comm));
+    if (photon_transport_ && !openmc::settings::photon_transport) {
+      throw std::runtime_error{
+        "<photon_transport> is on, but settings.xml turns photon transport off"};
+    }
   }
   MPI_Barrier(MPI_COMM_WORLD);
 
+  n_inactive_ = openmc::settings::n_inactive;
+  n_batches_ = openmc::settings::n_batches;
+  if (carry_inactive_ > n_inactive_) {
+    throw std::runtime_error{
+      "<carryover_inactive> must not exceed the inactive batches in settings.xml"};
+  }
+
   // determine number of fissionable cells in model to aid in catching
   // improperly mapped problems
   n_fissionable_cells_ = 0;
@@ -60,7 +153,6 @@ OpenmcDriver::OpenmcDriver(MPI_Comm comm)
   num_threads = omp_get_num_threads();
 #endif
 
-  timer_driver_setup.stop();
 }
 
 void OpenmcDriver::create_tallies()
@@ -68,15 +160,35 @@ void OpenmcDriver::create_tallies()
   using gsl::index;
   using gsl::narrow_cast;
 
+  // Scores other than kappa-fission deposit energy outside the fissionable cells, so
+  // the whole model is tallied to normalize them
+  if (heating_score_ == "heating" || heating_score_ == "heating-local") {
+    global_tally_ = openmc::Tally::create();
+    global_tally_->set_scores({heating_score_});
+  }
+
+  // Cells are still coupled for temperature and density, but they don't need tally bins
+  if (heat_mesh_) {
+    create_mesh_tally();
+    return;
+  }
+  if (heat_expansion_) {
+    create_expansion_tallies();
+    return;
+  }
+
   // Build vector of material indices on each rank
   // After CoupledDriver::init_mappings, the cells_ array is up-to-date on the root,
   // so we need to send that info to all the other ranks
   std::vector<int32_t> indices;
   std::vector<int32_t> instances;
   if (comm_.is_root()) {
-    for (const auto& c : cells_) {
+    bin_scale_ = xt::empty<double>({cells_.size()});
+    for (index i = 0; i < cells_.size(); ++i) {
+      const auto& c = cells_[i];
       indices.push_back(c.index_);
       instances.push_back(c.instance_);
+      bin_scale_(i) = 1.0 / c.volume_;
     }
   }
   comm_.broadcast(indices);
@@ -97,34 +209,130 @@ void OpenmcDriver::create_tallies()
 
   // Create tally and assign scores/filters
   tally_ = openmc::Tally::create();
-  tally_->set_scores({"kappa-fission"});
+  tally_->set_scores({heating_score_});
   tally_->add_filter(filter_);
 }
 
-xt::xtensor<double, 1> OpenmcDriver::heat_source(double power) const
+void OpenmcDriver::create_mesh_tally()
+{
+  // Give the mesh an ID that no mesh in the model uses
+  int32_t id = 0;
+  for (const auto& m : openmc::model::meshes) {
+    id = std::max(id, m->id_);
+  }
+  int32_t index;
+  err_chk(openmc_extend_meshes(1, "regular", &index, nullptr));
+  err_chk(openmc_mesh_set_id(index, id + 1));
+
+  const auto& m = *heat_mesh_;
+  double ll[3] = {m.lower_left_.x, m.lower_left_.y, m.lower_left_.z};
+  double ur[3] = {m.upper_right_.x, m.upper_right_.y, m.upper_right_.z};
+  err_chk(openmc_regular_mesh_set_dimension(index, 3, m.dimension_.data()));
+  err_chk(openmc_regular_mesh_set_params(index, 3, ll, ur, nullptr));
+
+  auto f = dynamic_cast<openmc::MeshFilter*>(openmc::Filter::create("mesh"));
+  f->set_mesh(index);
+
+  tally_ = openmc::Tally::create();
+  tally_->set_scores({heating_score_});
+  tally_->add_filter(f);
+
+  if (comm_.is_root()) {
+    bin_scale_ = xt::ones<double>({m.n_bins()}) / m.bin_volume();
+  }
+}
+
+void OpenmcDriver::create_expansion_tallies()
 {
-  // Determine number of realizations for normalizing tallies
-  int m = tally_->n_realizations_;
+  const auto& e = *heat_expansion_;
+  for (const auto& c : e.centers_) {
+    auto zf = dynamic_cast<openmc::ZernikeFilter*>(openmc::Filter::create("zernike"));
+    zf->set_order(e.zernike_order_);
+    zf->set_x(c[0]);
+    zf->set_y(c[1]);
+    zf->set_r(e.radius_);
+
+    auto lf = dynamic_cast<openmc::SpatialLegendreFilter*>(
+      openmc::Filter::create("spatiallegendre"));
+    lf->set_order(e.legendre_order_);
+    lf->set_axis(openmc::LegendreAxis::z);
+    lf->set_minmax(e.z_min_, e.z_max_);
+
+    // The last filter varies fastest, as the coefficients of PinExpansion do
+    auto t = openmc::Tally::create();
+    t->set_scores({heating_score_});
+    t->add_filter(zf);
+    t->add_filter(lf);
+    expansion_tallies_.push_back(t);
+  }
 
-  // Broadcast number of realizations
-  // TODO: Change OpenMC so that it's correct on all ranks
-  comm_.broadcast(m);
+  // The pins are identical, so they share the scales of their coefficients
+  if (comm_.is_root()) {
+    bin_scale_ = xt::empty<double>({e.n_coefficients()});
+    for (gsl::index k = 0; k < bin_scale_.size(); ++k) {
+      bin_scale_(k) = e.coefficient_scale(k);
+    }
+  }
+}
 
-  // Determine energy production in each material. Note that xt::view doesn't
-  // work with enum
+const HeatSourceBasis* OpenmcDriver::heat_basis() const
+{
+  if (heat_mesh_) {
+    return heat_mesh_.get();
+  }
+  return heat_expansion_.get();
+}
+
+double OpenmcDriver::heat_source_norm(double power) const
+{
+  // Get the energy production summed over all cells and realizations. The reduced
+  // results are always on the master, which is the root of comm_. Other ranks may
+  // also hold them (openmc_simulation_finalize broadcasts them) or may not (in a
+  // warm re-run), so only the root's own results are used.
   int i_sum = static_cast<int>(openmc::TallyResult::SUM);
-  auto mean_value = xt::view(tally_->results_, xt::all(), 0, i_sum);
-  xt::xtensor<double, 1> heat = JOULE_PER_EV * mean_value / m;
+  double total_heat = 0.0;
+  if (global_tally_) {
+    // Energy deposited in uncoupled cells, or outside the mesh or pins, is part of the
+    // power but not of the coupled heat source
+    total_heat = global_tally_->results_(0, 0, i_sum);
+  } else if (heat_expansion_) {
+    // The moment of Z_0^0 P_0, which are both 1, is the energy production in each pin
+    for (const auto t : expansion_tallies_) {
+      total_heat += t->results_(0, 0, i_sum);
+    }
+  } else {
+    total_heat = xt::sum(xt::view(tally_->results_, xt::all(), 0, i_sum))();
+  }
 
-  // Get total heat production [J/source]
-  double total_heat = xt::sum(heat)();
+  // The number of realizations and the [eV] -> [J] conversion appear in both the
+  // per-cell and total heat, so they cancel in the normalization
+  return power / total_heat;
+}
+
+xt::xtensor<double, 1> OpenmcDriver::heat_source(double power) const
+{
+  // Only the root needs the heat source
+  if (!comm_.is_root()) {
+    return {};
+  }
+  double norm = heat_source_norm(power);
 
-  // Convert heat from [J/source] to [W/cm^3]
-  gsl::index i = 0;
-  for (const auto& c : cells_) {
-    double V = c.volume_;
-    heat.at(i++) *= power / (total_heat * V);
+  // Determine energy production in each material, mesh bin, or coefficient and
+  // convert it from [W] to [W/cm^3] in a single pass over the reduced results. Note
+  // that xt::view doesn't work with enum
+  int i_sum = static_cast<int>(openmc::TallyResult::SUM);
+  if (heat_expansion_) {
+    auto n_coef = bin_scale_.size();
+    xt::xtensor<double, 1> heat = xt::empty<double>({heat_expansion_->size()});
+    for (std::size_t p = 0; p < expansion_tallies_.size(); ++p) {
+      auto sum_value = xt::view(expansion_tallies_[p]->results_, xt::all(), 0, i_sum);
+      xt::view(heat, xt::range(p * n_coef, (p + 1) * n_coef)) =
+        norm * sum_value * bin_scale_;
+    }
+    return heat;
   }
+  auto sum_value = xt::view(tally_->results_, xt::all(), 0, i_sum);
+  xt::xtensor<double, 1> heat = norm * sum_value * bin_scale_;
   return heat;
 }
 
@@ -212,42 +420,117 @@ const CellInstance& OpenmcDriver::cell_instance(CellHandle cell) const
 
 void OpenmcDriver::init_step()
 {
-  timer_init_step.start();
-  err_chk(openmc_simulation_init());
-  timer_init_step.stop();
+  auto timer = timers.scope("init_step");
+  set_batches();
+  if (warm_rerun_ && openmc::simulation::initialized) {
+    warm_reset();
+  } else {
+    err_chk(openmc_simulation_init());
+
+    // Replace the source sampled by openmc_simulation_init with the saved one
+    if (!source_.empty()) {
+      void* sites;
+      int64_t n;
+      err_chk(openmc_source_bank(&sites, &n));
+      if (static_cast<std::size_t>(n) != source_.size()) {
+        throw std::runtime_error{"Size of the OpenMC source bank changed between runs"};
+      }
+      std::copy(source_.begin(), source_.end(), static_cast<openmc::SourceSite*>(sites));
+    }
+  }
+}
+
+bool OpenmcDriver::carries_source() const
+{
+  return carry_source_ && (warm_rerun_ ? openmc::simulation::initialized : !source_.empty());
+}
+
+void OpenmcDriver::set_batches() const
+{
+  int n_inactive = n_inactive_;
+  if (carry_inactive_ >= 0 && carries_source() && temperature_norm_ < carry_norm_) {
+    n_inactive = carry_inactive_;
+  }
+  openmc::settings::n_inactive = n_inactive;
+  openmc::settings::n_batches = n_batches_ - n_inactive_ + n_inactive;
+}
+
+void OpenmcDriver::warm_reset()
+{
+  using namespace openmc;
+
+  // Count the generations of the previous run, so that this run samples different
+  // random number streams
+  simulation::total_gen += simulation::current_batch * settings::gen_per_batch;
+
+  // Restart the batch count; tallies are activated again at the first active batch
+  simulation::current_batch = 0;
+  simulation::k_generation.clear();
+  simulation::entropy.clear();
+  for (auto& t : model::tallies) {
+    t->active_ = false;
+  }
+  err_chk(openmc_reset());
+
+  // The source bank still holds the fission source of the previous run, which is kept
+  // if it is carried over
+  if (!carry_source_) {
+    initialize_source();
+  }
 }
 
 void OpenmcDriver::solve_step()
 {
-  timer_solve_step.start();
-  err_chk(openmc_run());
+  auto timer = timers.scope("solve_step");
+  if (warm_rerun_ || carry_source_) {
+    // openmc_run would finalize the simulation after its last batch
+    int status = 0;
+    while (status == 0) {
+      err_chk(openmc_next_batch(&status));
+    }
+
+    // After the last batch, the source bank holds the fission source of the next
+    // generation.  A warm re-run keeps it in place.
+    if (carry_source_ && !warm_rerun_) {
+      void* sites;
+      int64_t n;
+      err_chk(openmc_source_bank(&sites, &n));
+      auto first = static_cast<const openmc::SourceSite*>(sites);
+      source_.assign(first, first + n);
+    }
+  } else {
+    err_chk(openmc_run());
+  }
   err_chk(openmc_reset_timers());
-  timer_solve_step.stop();
 }
 
 void OpenmcDriver::write_step(int timestep, int iteration)
 {
-  timer_write_step.start();
+  auto timer = timers.scope("write_step");
+  auto files = output_files(timestep, iteration);
+  err_chk(openmc_statepoint_write(files[0].c_str(), nullptr));
+  err_chk(openmc_properties_export(files[1].c_str()));
+}
+
+std::vector<std::string> OpenmcDriver::output_files(int timestep, int iteration) const
+{
   std::string suffix{"_t" + std::to_string(timestep) + "_i" + std::to_string(iteration) +
                      ".h5"};
-  std::string filename{"openmc" + suffix};
-  err_chk(openmc_statepoint_write(filename.c_str(), nullptr));
-
-  std::string prop_file{"properties" + suffix};
-  err_chk(openmc_properties_export(prop_file.c_str()));
-  timer_write_step.stop();
+  return {"openmc" + suffix, "properties" + suffix};
 }
 
 void OpenmcDriver::finalize_step()
 {
-  timer_finalize_step.start();
-  err_chk(openmc_simulation_finalize());
-  timer_finalize_step.stop();
+  auto timer = timers.scope("finalize_step");
+  if (!warm_rerun_) {
+    err_chk(openmc_simulation_finalize());
+  }
 }
 
 OpenmcDriver::~OpenmcDriver()
 {
   if (active()) {
+    err_chk(openmc_simulation_finalize());
     err_chk(openmc_finalize());
   }
   MPI_Barrier(MPI_COMM_WORLD);
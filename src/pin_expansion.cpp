@@ -0,0 +1,144 @@
+#include "enrico/pin_expansion.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+namespace enrico {
+
+namespace {
+
+double factorial(int n)
+{
+  double f = 1.0;
+  for (int i = 2; i <= n; ++i) {
+    f *= i;
+  }
+  return f;
+}
+
+} // namespace
+
+std::vector<double> zernike(int order, double rho, double phi)
+{
+  std::vector<double> z;
+  z.reserve((order + 1) * (order + 2) / 2);
+  for (int n = 0; n <= order; ++n) {
+    for (int m = -n; m <= n; m += 2) {
+      int am = std::abs(m);
+
+      // Radial polynomial R_n^|m|
+      double radial = 0.0;
+      for (int k = 0; k <= (n - am) / 2; ++k) {
+        double c = factorial(n - k) / (factorial(k) * factorial((n + am) / 2 - k) *
+                                       factorial((n - am) / 2 - k));
+        radial += (k % 2 == 0 ? c : -c) * std::pow(rho, n - 2 * k);
+      }
+
+      double norm = m == 0 ? std::sqrt(n + 1.0) : std::sqrt(2.0 * (n + 1));
+      double angular = m < 0 ? std::sin(am * phi) : std::cos(m * phi);
+      z.push_back(norm * radial * angular);
+    }
+  }
+  return z;
+}
+
+std::vector<double> legendre(int order, double x)
+{
+  std::vector<double> p(order + 1);
+  p[0] = 1.0;
+  if (order > 0) {
+    p[1] = x;
+  }
+  for (int l = 2; l <= order; ++l) {
+    p[l] = ((2 * l - 1) * x * p[l - 1] - (l - 1) * p[l - 2]) / l;
+  }
+  return p;
+}
+
+PinExpansion::PinExpansion(std::vector<std::array<double, 2>> centers,
+                           double radius,
+                           double z_min,
+                           double z_max,
+                           int zernike_order,
+                           int legendre_order)
+  : centers_(std::move(centers))
+  , radius_(radius)
+  , z_min_(z_min)
+  , z_max_(z_max)
+  , zernike_order_(zernike_order)
+  , legendre_order_(legendre_order)
+{
+  if (centers_.empty()) {
+    throw std::runtime_error{"A pin expansion must have at least one pin"};
+  }
+  if (!(radius_ > 0.0 && z_max_ > z_min_)) {
+    throw std::runtime_error{
+      "Pins of an expansion must have a positive radius and height"};
+  }
+  if (zernike_order_ < 0 || legendre_order_ < 0) {
+    throw std::runtime_error{"Orders of a pin expansion must not be negative"};
+  }
+}
+
+gsl::index PinExpansion::pin(const Position& r) const
+{
+  if (r.z < z_min_ || r.z > z_max_) {
+    return -1;
+  }
+  for (gsl::index i = 0; i < centers_.size(); ++i) {
+    double dx = r.x - centers_[i][0];
+    double dy = r.y - centers_[i][1];
+    if (dx * dx + dy * dy <= radius_ * radius_) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+double PinExpansion::coefficient_scale(gsl::index k) const
+{
+  // Each Zernike polynomial squared integrates to the area of the pin, and the
+  // Legendre polynomial of order l squared integrates to its height / (2l + 1)
+  int l = k % n_legendre();
+  double area = M_PI * radius_ * radius_;
+  return (2 * l + 1) / (area * (z_max_ - z_min_));
+}
+
+double PinExpansion::integral(const xt::xtensor<double, 1>& values) const
+{
+  Expects(values.size() == size());
+  double pin_volume = M_PI * radius_ * radius_ * (z_max_ - z_min_);
+  double power = 0.0;
+  for (std::size_t i = 0; i < n_pins(); ++i) {
+    power += values[i * n_coefficients()] * pin_volume;
+  }
+  return power;
+}
+
+void PinExpansion::weights(const Position& r,
+                           std::vector<gsl::index>& indices,
+                           std::vector<double>& weights) const
+{
+  auto i = pin(r);
+  if (i < 0) {
+    return;
+  }
+
+  double dx = r.x - centers_[i][0];
+  double dy = r.y - centers_[i][1];
+  double rho = std::sqrt(dx * dx + dy * dy) / radius_;
+  auto z = zernike(zernike_order_, rho, std::atan2(dy, dx));
+  auto p = legendre(legendre_order_, 2.0 * (r.z - z_min_) / (z_max_ - z_min_) - 1.0);
+
+  gsl::index k = i * n_coefficients();
+  for (double zn : z) {
+    for (double pl : p) {
+      indices.push_back(k++);
+      weights.push_back(zn * pl);
+    }
+  }
+}
+
+} // namespace enrico
@@ -0,0 +1,79 @@
+#include "enrico/regular_mesh.h"
+
+#include <cmath>
+#include <numeric> // for accumulate
+#include <stdexcept>
+
+namespace enrico {
+
+RegularMesh::RegularMesh(Position lower_left,
+                         Position upper_right,
+                         std::array<int, 3> dimension)
+  : lower_left_(lower_left)
+  , upper_right_(upper_right)
+  , dimension_(dimension)
+{
+  if (!(upper_right.x > lower_left.x && upper_right.y > lower_left.y &&
+        upper_right.z > lower_left.z)) {
+    throw std::runtime_error{"Upper-right corner of a mesh must exceed its lower-left"};
+  }
+  for (int n : dimension) {
+    if (n < 1) {
+      throw std::runtime_error{"A mesh must have at least one bin in each direction"};
+    }
+  }
+}
+
+gsl::index RegularMesh::bin(const Position& r) const
+{
+  const std::array<double, 3> x{r.x, r.y, r.z};
+  const std::array<double, 3> lo{lower_left_.x, lower_left_.y, lower_left_.z};
+  const std::array<double, 3> hi{upper_right_.x, upper_right_.y, upper_right_.z};
+
+  gsl::index index = 0;
+  gsl::index stride = 1;
+  for (int d = 0; d < 3; ++d) {
+    if (x[d] < lo[d] || x[d] > hi[d]) {
+      return -1;
+    }
+    // Positions on the upper boundary belong to the last bin
+    auto i = static_cast<gsl::index>(
+      std::floor((x[d] - lo[d]) / (hi[d] - lo[d]) * dimension_[d]));
+    if (i == dimension_[d]) {
+      --i;
+    }
+    index += i * stride;
+    stride *= dimension_[d];
+  }
+  return index;
+}
+
+void RegularMesh::weights(const Position& r,
+                          std::vector<gsl::index>& indices,
+                          std::vector<double>& weights) const
+{
+  auto i = bin(r);
+  if (i >= 0) {
+    indices.push_back(i);
+    weights.push_back(1.0);
+  }
+}
+
+std::size_t RegularMesh::n_bins() const
+{
+  return static_cast<std::size_t>(dimension_[0]) * dimension_[1] * dimension_[2];
+}
+
+double RegularMesh::integral(const xt::xtensor<double, 1>& values) const
+{
+  Expects(values.size() == n_bins());
+  return std::accumulate(values.cbegin(), values.cend(), 0.0) * bin_volume();
+}
+
+double RegularMesh::bin_volume() const
+{
+  return (upper_right_.x - lower_left_.x) * (upper_right_.y - lower_left_.y) *
+         (upper_right_.z - lower_left_.z) / n_bins();
+}
+
+} // namespace enrico
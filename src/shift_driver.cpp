@@ -14,7 +14,7 @@ namespace enrico {
 ShiftDriver::ShiftDriver(MPI_Comm comm, pugi::xml_node node)
   : NeutronicsDriver{comm}
 {
-  timer_driver_setup.start();
+  auto timer = timers.scope("driver_setup");
   if (this->active()) {
     // Get Shift filename
     if (!node.child("filename")) {
@@ -60,7 +60,6 @@ ShiftDriver::ShiftDriver(MPI_Comm comm, pugi::xml_node node)
   num_threads = omp_get_num_threads();
 #endif
 
-  timer_driver_setup.stop();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -220,17 +219,15 @@ gsl::index ShiftDriver::cell_index(CellHandle cell) const
 
 void ShiftDriver::init_step()
 {
-  timer_init_step.start();
+  auto timer = timers.scope("init_step");
   // Rebuild problem (loading any new data needed and run transport
   driver_->rebuild();
-  timer_init_step.stop();
 }
 
 void ShiftDriver::solve_step()
 {
-  timer_solve_step.start();
+  auto timer = timers.scope("solve_step");
   driver_->run();
-  timer_solve_step.stop();
 }
 
 } // end namespace enrico
@@ -412,12 +412,15 @@ double SurrogateHeatDriver::rod_axial_node_power(const int pin, const int axial)
 
 void SurrogateHeatDriver::solve_step()
 {
-  timer_solve_step.start();
+  auto timer = timers.scope("solve_step");
   if (has_coupling_data()) {
-    solve_fluid();
+    {
+      auto fluid_timer = timers.scope("solve_fluid");
+      solve_fluid();
+    }
+    auto heat_timer = timers.scope("solve_heat");
     solve_heat();
   }
-  timer_solve_step.stop();
 }
 
 void SurrogateHeatDriver::solve_fluid()
@@ -657,8 +660,7 @@ double SurrogateHeatDriver::fluid_temperature(std::size_t pin, std::size_t axial
 
 void SurrogateHeatDriver::write_step(int timestep, int iteration)
 {
-  // TODO: Timers deadlock here...
-  // timer_write_step.start();
+  auto timer = timers.scope("write_step");
   if (!has_coupling_data())
     return;
 
@@ -670,19 +672,33 @@ void SurrogateHeatDriver::write_step(int timestep, int iteration)
   }
 
   // otherwise construct an appropriate filename and write the data
+  std::string filename = vtk_filename(timestep, iteration);
+
+  SurrogateVtkWriter vtk_writer(*this, vtk_radial_res_, viz_regions_, viz_data_);
+
+  comm_.message("Writing VTK file: " + filename);
+  vtk_writer.write(filename);
+  return;
+}
+
+std::vector<std::string> SurrogateHeatDriver::output_files(int timestep,
+                                                           int iteration) const
+{
+  if (iteration >= 0 && "all" != viz_iterations_) {
+    return {};
+  }
+  return {vtk_filename(timestep, iteration)};
+}
+
+std::string SurrogateHeatDriver::vtk_filename(int timestep, int iteration) const
+{
   std::stringstream filename;
   filename << viz_basename_;
   if (iteration >= 0 && timestep >= 0) {
     filename << "_t" << timestep << "_i" << iteration;
   }
   filename << ".vtk";
-
-  SurrogateVtkWriter vtk_writer(*this, vtk_radial_res_, viz_regions_, viz_data_);
-
-  comm_.message("Writing VTK file: " + filename.str());
-  vtk_writer.write(filename.str());
-  // timer_write_step.stop();
-  return;
+  return filename.str();
 }
 
 } // namespace enrico
@@ -4,46 +4,415 @@
 
 #include "enrico/timer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
 namespace enrico {
 
-void Timer::start()
+TimerRegistry timers;
+
+namespace {
+
+//! Paths of the regions open on the calling thread, innermost last
+thread_local std::vector<std::string> open_paths;
+
+//! Index of the calling thread, assigned in the order threads first record a region
+int thread_index()
+{
+  static std::atomic<int> n_threads{0};
+  thread_local int index = n_threads++;
+  return index;
+}
+
+//! Escape a string for use in a JSON string literal
+std::string json_escape(const std::string& s)
+{
+  std::string escaped;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+} // namespace
+
+TimerRegistry::Scope::Scope(TimerRegistry& registry,
+                            const std::string& name,
+                            const Comm* comm,
+                            bool nested)
+  : registry_(&registry)
+  , path_(open_paths.empty() || !nested ? name : open_paths.back() + "/" + name)
+  , comm_(comm)
+  , nested_(nested)
+{
+  if (nested_) {
+    open_paths.push_back(path_);
+    counted_ = registry.hw_counters_enabled() && read_hw_counters(counts_);
+    tracked_ = registry.memory_tracking_enabled() && read_memory_usage(memory_);
+    allocations_ = thread_allocations();
+  }
+  if (comm_ && comm_->active()) {
+    comm_->Barrier();
+  }
+  start_ = std::chrono::steady_clock::now();
+}
+
+TimerRegistry::Scope::Scope(Scope&& other) noexcept
+  : registry_(other.registry_)
+  , path_(std::move(other.path_))
+  , comm_(other.comm_)
+  , nested_(other.nested_)
+  , counted_(other.counted_)
+  , counts_(other.counts_)
+  , tracked_(other.tracked_)
+  , memory_(other.memory_)
+  , allocations_(other.allocations_)
+  , start_(other.start_)
+{
+  other.registry_ = nullptr;
+}
+
+TimerRegistry::Scope::~Scope()
+{
+  if (registry_) {
+    if (comm_ && comm_->active()) {
+      comm_->Barrier();
+    }
+    registry_->add(path_, start_, std::chrono::steady_clock::now(), nested_);
+    HwCounts counts;
+    if (counted_ && read_hw_counters(counts)) {
+      registry_->add_hw(path_, counts - counts_);
+    }
+    MemoryUsage memory;
+    if (tracked_ && read_memory_usage(memory)) {
+      auto allocations = thread_allocations();
+      registry_->add_memory(path_,
+                            {memory.rss,
+                             memory.hwm - memory_.hwm,
+                             allocations.allocated - allocations_.allocated,
+                             allocations.allocations - allocations_.allocations});
+    }
+    if (nested_) {
+      open_paths.pop_back();
+    }
+  }
+}
+
+void TimerRegistry::add(const std::string& path,
+                        Clock::time_point start,
+                        Clock::time_point end,
+                        bool timed)
+{
+  using Micro = std::chrono::duration<double, std::micro>;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (timed) {
+    times_[path] += std::chrono::duration<double>(end - start).count();
+  }
+  if (tracing_ && start >= trace_start_) {
+    events_.push_back({path,
+                       Micro(start - trace_start_).count(),
+                       Micro(end - start).count(),
+                       thread_index()});
+  }
+}
+
+void TimerRegistry::add_hw(const std::string& path, const HwCounts& counts)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  hw_counts_[path] += counts;
+}
+
+void TimerRegistry::add_memory(const std::string& path, const MemoryCounts& counts)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& c = memory_counts_[path];
+  c.rss = std::max(c.rss, counts.rss);
+  c.hwm_growth += counts.hwm_growth;
+  c.allocated += counts.allocated;
+  c.allocations += counts.allocations;
+}
+
+void TimerRegistry::memory_report(const Comm& comm) const
+{
+  if (!comm.active()) {
+    return;
+  }
+
+  constexpr double mib = 1024.0 * 1024.0;
+
+  // The high-water mark of the whole process is reduced with the ranks of its extremes
+  MemoryUsage usage;
+  read_memory_usage(usage);
+  const double local_hwm = usage.hwm / mib;
+  std::vector<ValueRank> hwm{{local_hwm, 0}, {-local_hwm, 0}};
+  std::vector<double> hwm_sum{local_hwm};
+  comm.reduce_loc(hwm, MPI_MAXLOC);
+  comm.reduce(hwm_sum, MPI_SUM);
+
+  std::stringstream msg;
+  msg << "  Memory high-water mark (MiB): max " << std::fixed << std::setprecision(1)
+      << hwm[0].value << " on rank " << hwm[0].rank << ", min " << -hwm[1].value
+      << " on rank " << hwm[1].rank << ", avg " << hwm_sum[0] / comm.size;
+  comm.message(msg.str());
+
+  std::map<std::string, MemoryCounts> local;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    local = memory_counts_;
+  }
+  std::set<std::string> names;
+  for (const auto& c : local) {
+    names.insert(c.first);
+  }
+  auto keys = comm.union_names(names);
+
+  // Largest resident set sizes and high-water-mark growths are reduced with the ranks
+  // they came from, and allocations are summed
+  const std::size_t n = keys.size();
+  std::vector<ValueRank> largest(2 * n, ValueRank{0.0, 0});
+  std::vector<std::size_t> sums(2 * n, 0);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto it = local.find(keys[i]);
+    if (it != local.end()) {
+      const auto& c = it->second;
+      largest[i].value = c.rss / mib;
+      largest[n + i].value = c.hwm_growth / mib;
+      sums[i] = c.allocated;
+      sums[n + i] = c.allocations;
+    }
+  }
+  comm.reduce_loc(largest, MPI_MAXLOC);
+  comm.reduce(sums, MPI_SUM);
+
+  const bool counted = allocations_counted();
+  comm.message(counted ? "  Memory (max RSS MiB and its rank, max high-water-mark growth "
+                         "MiB and its rank, allocated MiB, allocations)"
+                       : "  Memory (max RSS MiB and its rank, max high-water-mark growth "
+                         "MiB and its rank)");
+  for (std::size_t i = 0; i < n; ++i) {
+    std::stringstream msg;
+    msg << "    " << std::setw(40) << std::left << keys[i] << std::right << std::fixed
+        << std::setprecision(1) << std::setw(10) << largest[i].value << std::setw(8)
+        << largest[i].rank << std::setw(10) << largest[n + i].value << std::setw(8)
+        << largest[n + i].rank;
+    if (counted) {
+      msg << std::setw(12) << sums[i] / mib << std::setw(12) << sums[n + i];
+    }
+    comm.message(msg.str());
+  }
+}
+
+void TimerRegistry::hw_report(const Comm& comm) const
 {
-  if (comm_.active()) {
-    running_ = true;
-    comm_.Barrier();
-    start_ = MPI_Wtime();
+  if (!comm.active()) {
+    return;
+  }
+
+  std::map<std::string, HwCounts> local;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    local = hw_counts_;
+  }
+  std::set<std::string> names;
+  for (const auto& c : local) {
+    names.insert(c.first);
+  }
+  auto keys = comm.union_names(names);
+
+  // Counts are summed, and the instructions per cycle of each rank that ran a region
+  // are reduced with the rank they came from
+  const std::size_t n = keys.size();
+  std::vector<std::uint64_t> sums(4 * n, 0);
+  std::vector<ValueRank> ipc(n, ValueRank{std::numeric_limits<double>::max(), 0});
+  for (std::size_t i = 0; i < n; ++i) {
+    auto it = local.find(keys[i]);
+    if (it != local.end()) {
+      const auto& c = it->second;
+      sums[i] = c.cycles;
+      sums[n + i] = c.instructions;
+      sums[2 * n + i] = c.cache_misses;
+      sums[3 * n + i] = c.branch_misses;
+      if (c.cycles > 0) {
+        ipc[i].value = static_cast<double>(c.instructions) / c.cycles;
+      }
+    }
+  }
+  comm.reduce(sums, MPI_SUM);
+  comm.reduce_loc(ipc, MPI_MINLOC);
+
+  // The counts include child threads only if every rank's counters were inherited
+  int inherited = hw_counters_inherited() ? 1 : 0;
+  comm.reduce(inherited, MPI_MIN);
+
+  comm.message("  Hardware counters (cycles, instructions per cycle, cache misses and "
+               "branch misses per 1000 instructions, lowest IPC and its rank)");
+  comm.message(inherited ? "  Counts include the threads started by each timed thread"
+                         : "  Counts are for each timed thread only, not the threads it "
+                           "starts");
+  for (std::size_t i = 0; i < n; ++i) {
+    double kinstr = sums[n + i] / 1000.0;
+    auto per_kinstr = [kinstr](std::uint64_t x) {
+      return kinstr > 0.0 ? x / kinstr : 0.0;
+    };
+    std::stringstream msg;
+    msg << "    " << std::setw(40) << std::left << keys[i] << std::right
+        << std::scientific << std::setprecision(4) << static_cast<double>(sums[i])
+        << std::fixed << std::setprecision(3) << std::setw(10)
+        << (sums[i] > 0 ? static_cast<double>(sums[n + i]) / sums[i] : 0.0)
+        << std::setw(10) << per_kinstr(sums[2 * n + i]) << std::setw(10)
+        << per_kinstr(sums[3 * n + i]);
+    if (ipc[i].value < std::numeric_limits<double>::max()) {
+      msg << std::setw(10) << ipc[i].value << std::setw(8) << ipc[i].rank;
+    }
+    comm.message(msg.str());
   }
 }
 
-void Timer::stop()
+void TimerRegistry::start_trace(const Comm& comm)
 {
-  if (comm_.active()) {
-    elapsed_ = elapsed();
-    running_ = false;
+  if (comm.active()) {
+    comm.Barrier();
   }
+  std::lock_guard<std::mutex> lock(mutex_);
+  tracing_ = true;
+  trace_start_ = Clock::now();
+  events_.clear();
 }
 
-void Timer::reset()
+void TimerRegistry::write_trace(const std::string& filename, const Comm& comm) const
 {
-  if (comm_.active()) {
-    running_ = false;
-    elapsed_ = 0.0;
+  if (!comm.active()) {
+    return;
+  }
+
+  // Each rank formats its own events, which the root then writes in rank order
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(3);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& e : events_) {
+      auto pos = e.path.rfind('/');
+      auto name = pos == std::string::npos ? e.path : e.path.substr(pos + 1);
+      os << "{\"name\":\"" << json_escape(name) << "\",\"cat\":\""
+         << json_escape(e.path) << "\",\"ph\":\"X\",\"ts\":" << e.start
+         << ",\"dur\":" << e.duration << ",\"pid\":" << comm.rank
+         << ",\"tid\":" << e.thread << "},\n";
+    }
+  }
+  std::string local = os.str();
+  std::vector<char> events{local.begin(), local.end()};
+  std::vector<char> all_events;
+  std::vector<int> counts;
+  comm.gatherv(events, all_events, counts);
+
+  if (comm.is_root()) {
+    std::ofstream out{filename};
+    if (!out) {
+      throw std::runtime_error{"Unable to open trace file " + filename};
+    }
+    std::ostringstream body;
+    for (int r = 0; r < comm.size; ++r) {
+      body << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << r
+           << ",\"args\":{\"name\":\"rank " << r << "\"}},\n";
+    }
+    body.write(all_events.data(), all_events.size());
+
+    // Drop the separator after the last event
+    auto text = body.str();
+    text.resize(text.size() - 2);
+    out << "[\n" << text << "\n]\n";
   }
 }
 
-double Timer::elapsed()
+std::string TimerRegistry::current_path()
 {
-  if (comm_.active()) {
-    if (running_) {
-      comm_.Barrier();
-      auto diff = MPI_Wtime() - start_;
-      return elapsed_ + diff;
-    } else {
-      return elapsed_;
+  return open_paths.empty() ? std::string{} : open_paths.back();
+}
+
+double TimerRegistry::elapsed(const std::string& path) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = times_.find(path);
+  return it == times_.end() ? 0.0 : it->second;
+}
+
+void TimerRegistry::reset()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  times_.clear();
+  hw_counts_.clear();
+  memory_counts_.clear();
+}
+
+std::vector<TimeAmt> TimerRegistry::aggregate(const std::string& path,
+                                              const Comm& comm) const
+{
+  std::vector<TimeAmt> result;
+  if (!comm.active()) {
+    return result;
+  }
+
+  // Times of the regions directly nested in path on this rank
+  const std::string prefix = path + "/";
+  std::map<std::string, double> local;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& t : times_) {
+      if (t.first.compare(0, prefix.size(), prefix) == 0 &&
+          t.first.find('/', prefix.size()) == std::string::npos) {
+        local.emplace(t.first.substr(prefix.size()), t.second);
+      }
+    }
+  }
+
+  // Ranks may close different regions, so agree on the union of their names first
+  std::set<std::string> names;
+  for (const auto& t : local) {
+    names.insert(t.first);
+  }
+  auto keys = comm.union_names(names);
+
+  // Largest times and negated smallest times are reduced together with the ranks they
+  // came from, and sums of times are reduced with numbers of ranks that closed each
+  // region
+  const std::size_t n = keys.size();
+  std::vector<ValueRank> extremes(2 * n,
+                                  ValueRank{std::numeric_limits<double>::lowest(), 0});
+  std::vector<double> sums(2 * n, 0.0);
+  std::size_t i = 0;
+  for (const auto& k : keys) {
+    auto it = local.find(k);
+    if (it != local.end()) {
+      extremes[i].value = it->second;
+      extremes[n + i].value = -it->second;
+      sums[i] = it->second;
+      sums[n + i] = 1.0;
     }
-  } else {
-    return 0.0;
+    ++i;
   }
+  comm.reduce_loc(extremes, MPI_MAXLOC);
+  comm.reduce(sums, MPI_SUM);
+
+  i = 0;
+  for (const auto& k : keys) {
+    TimeAmt t{k, extremes[i].value};
+    t.min = -extremes[n + i].value;
+    t.avg = sums[i] / sums[n + i];
+    t.slowest = extremes[i].rank;
+    result.push_back(t);
+    ++i;
+  }
+  return result;
 }
 
 double TimeAmt::sum_times(const std::vector<TimeAmt>& times)
@@ -70,16 +439,62 @@ void TimeAmt::print_times(const std::string& header_name,
 {
   std::ios_base::fmtflags old_flags(std::cout.flags());
   std::stringstream msg;
-  msg << "  " << header_name << " time (seconds, percent)";
+  msg << "  " << header_name << " time (seconds, percent, min, avg)";
   comm.message(msg.str());
   for (const auto& t : times) {
     std::stringstream msg;
     msg << "    " << std::setw(22) << std::left << t.name << std::right << std::scientific
         << std::setprecision(4) << t.time << "    " << std::setw(8) << std::fixed
-        << std::left << std::right << t.percent * 100.0;
+        << std::left << std::right << t.percent * 100.0 << "    " << std::scientific
+        << t.min << "    " << t.avg;
     comm.message(msg.str());
   }
   std::cout.flags(old_flags);
 }
 
+void TimeAmt::print_imbalance(const std::string& header_name,
+                              const std::vector<TimeAmt>& times,
+                              const Comm& comm)
+{
+  std::stringstream msg;
+  msg << "  " << header_name << " imbalance (max/avg, slowest rank)";
+  comm.message(msg.str());
+  for (const auto& t : times) {
+    std::stringstream msg;
+    msg << "    " << std::setw(22) << std::left << t.name << std::right << std::fixed
+        << std::setprecision(3) << std::setw(10) << t.imbalance() << "    "
+        << std::setw(8) << t.slowest;
+    comm.message(msg.str());
+  }
+}
+
+std::vector<TimeAmt> TimeAmt::read_times(std::istream& is,
+                                         const std::string& header_name)
+{
+  const std::string header = header_name + " time (";
+  std::vector<TimeAmt> times;
+  bool in_block = false;
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line.find(header) != std::string::npos) {
+      times.clear();
+      in_block = true;
+      continue;
+    }
+    if (in_block) {
+      // Skip the prefix added by Comm::message
+      auto pos = line.find("]:");
+      std::istringstream fields{pos == std::string::npos ? line : line.substr(pos + 2)};
+      std::string name;
+      double time, percent;
+      if (fields >> name >> time >> percent) {
+        times.emplace_back(name, time, percent / 100.0);
+      } else {
+        in_block = false;
+      }
+    }
+  }
+  return times;
+}
+
 }
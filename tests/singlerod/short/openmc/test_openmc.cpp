@@ -5,7 +5,8 @@ int main(int argc, char *argv[]) {
   MPI_Init(&argc, &argv);
 
   {
-    enrico::OpenmcDriver test_driver(MPI_COMM_WORLD);
+    // An empty <neutronics> node leaves every OpenMC option at its default
+    enrico::OpenmcDriver test_driver(MPI_COMM_WORLD, pugi::xml_node{});
     test_driver.init_step();
     test_driver.solve_step();
     test_driver.write_step(0, 0);
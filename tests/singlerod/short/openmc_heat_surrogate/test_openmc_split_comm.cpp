@@ -34,7 +34,7 @@ public:
 
     // Instantiate neutronics driver
     std::string neut_driver = neut_node.child_value("driver");
-    neutronics_driver_ = std::make_unique<OpenmcDriver>(neutronics_comm.comm);
+    neutronics_driver_ = std::make_unique<OpenmcDriver>(neutronics_comm.comm, neut_node);
 
     // Instantiate heat-fluids driver
     std::string s = heat_node.child_value("driver");
@@ -1,2 +1,17 @@
-#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_RUNNER
 #include "catch.hpp"
+#include "enrico/mpi_types.h"
+
+#include <mpi.h>
+
+// Tests of Comm run on all ranks of MPI_COMM_WORLD, so the unit tests may be run with
+// mpiexec as well as on their own
+int main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+  enrico::init_mpi_datatypes();
+  int result = Catch::Session().run(argc, argv);
+  enrico::free_mpi_datatypes();
+  MPI_Finalize();
+  return result;
+}
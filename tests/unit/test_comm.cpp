@@ -0,0 +1,211 @@
+/**
+ * \file test_comm.cpp
+ * \brief Unit tests for the collective operations of Comm.  They run on any number of
+ * ranks, and are meant to be run on more than one.
+ */
+
+#include "catch.hpp"
+#include "enrico/comm.h"
+
+#include <mpi.h>
+#include <xtensor/xtensor.hpp>
+
+#include <vector>
+
+using enrico::Comm;
+
+using Shape = xt::xtensor<int, 1>::shape_type;
+
+TEST_CASE("Reduce values onto a root", "[comm]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  int n = comm.size;
+  int root = n - 1;
+
+  SECTION("Scalar")
+  {
+    int value = comm.rank + 1;
+    comm.reduce(value, MPI_SUM, root);
+    if (comm.rank == root) {
+      CHECK(value == n * (n + 1) / 2);
+    }
+  }
+
+  SECTION("Vector")
+  {
+    std::vector<double> values{static_cast<double>(comm.rank), 1.0};
+    comm.reduce(values, MPI_MAX, root);
+    if (comm.rank == root) {
+      CHECK(values == std::vector<double>{n - 1.0, 1.0});
+    }
+  }
+
+  SECTION("xtensor")
+  {
+    xt::xtensor<int, 1> values(Shape{3}, 1);
+    comm.reduce(values, MPI_SUM, root);
+    if (comm.rank == root) {
+      CHECK(std::vector<int>(values.begin(), values.end()) == std::vector<int>(3, n));
+    }
+  }
+
+  SECTION("Nonblocking")
+  {
+    std::vector<long> values{comm.rank + 1L, 2L};
+    auto request = comm.ireduce(values.data(), values.size(), MPI_SUM, root);
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    if (comm.rank == root) {
+      CHECK(values == std::vector<long>{n * (n + 1L) / 2, 2L * n});
+    }
+  }
+}
+
+TEST_CASE("Reduce values onto all ranks", "[comm]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  int n = comm.size;
+
+  SECTION("Scalar")
+  {
+    double value = comm.rank;
+    comm.allreduce(value, MPI_MAX);
+    CHECK(value == n - 1.0);
+  }
+
+  SECTION("Vector")
+  {
+    std::vector<int> values{comm.rank, -comm.rank};
+    comm.allreduce(values, MPI_MIN);
+    CHECK(values == std::vector<int>{0, 1 - n});
+  }
+
+  SECTION("xtensor")
+  {
+    xt::xtensor<double, 1> values(Shape{2}, 0.5);
+    comm.allreduce(values, MPI_SUM);
+    CHECK(std::vector<double>(values.begin(), values.end()) ==
+          std::vector<double>(2, 0.5 * n));
+  }
+
+  SECTION("Nonblocking")
+  {
+    std::vector<int> values{1};
+    auto request = comm.iallreduce(values.data(), values.size(), MPI_SUM);
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    CHECK(values[0] == n);
+  }
+}
+
+TEST_CASE("Reduce extremes with their ranks onto a root", "[comm]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  int n = comm.size;
+  int root = n - 1;
+
+  // The first value is largest on the last rank and the second is the same on all
+  // ranks, so its extremes come from rank 0
+  std::vector<enrico::ValueRank> values{{static_cast<double>(comm.rank), -1},
+                                        {1.0, -1}};
+
+  SECTION("Largest")
+  {
+    comm.reduce_loc(values, MPI_MAXLOC, root);
+    if (comm.rank == root) {
+      CHECK(values[0].value == n - 1.0);
+      CHECK(values[0].rank == n - 1);
+      CHECK(values[1].value == 1.0);
+      CHECK(values[1].rank == 0);
+    }
+  }
+
+  SECTION("Smallest")
+  {
+    comm.reduce_loc(values, MPI_MINLOC, root);
+    if (comm.rank == root) {
+      CHECK(values[0].value == 0.0);
+      CHECK(values[0].rank == 0);
+      CHECK(values[1].value == 1.0);
+      CHECK(values[1].rank == 0);
+    }
+  }
+}
+
+TEST_CASE("Gather and scatter pieces of different sizes", "[comm]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  int n = comm.size;
+
+  // Rank r holds r + 1 copies of r
+  std::vector<int> piece(comm.rank + 1, comm.rank);
+  std::vector<int> all;
+  std::vector<int> counts;
+  for (int r = 0; r < n; ++r) {
+    all.insert(all.end(), r + 1, r);
+    counts.push_back(r + 1);
+  }
+
+  SECTION("Gather vectors")
+  {
+    std::vector<int> recv;
+    std::vector<int> recv_counts;
+    comm.gatherv(piece, recv, recv_counts);
+    if (comm.is_root()) {
+      CHECK(recv == all);
+      CHECK(recv_counts == counts);
+    }
+  }
+
+  SECTION("Gather xtensors")
+  {
+    xt::xtensor<int, 1> send(Shape{piece.size()});
+    std::copy(piece.begin(), piece.end(), send.begin());
+    xt::xtensor<int, 1> recv;
+    std::vector<int> recv_counts;
+    comm.gatherv(send, recv, recv_counts);
+    if (comm.is_root()) {
+      CHECK(std::vector<int>(recv.begin(), recv.end()) == all);
+      CHECK(recv_counts == counts);
+    }
+  }
+
+  SECTION("Scatter vectors")
+  {
+    std::vector<int> recv;
+    comm.scatterv(comm.is_root() ? all : std::vector<int>{}, counts, recv);
+    CHECK(recv == piece);
+  }
+
+  SECTION("Scatter xtensors")
+  {
+    xt::xtensor<int, 1> send(Shape{all.size()});
+    std::copy(all.begin(), all.end(), send.begin());
+    xt::xtensor<int, 1> recv;
+    comm.scatterv(send, counts, recv);
+    CHECK(std::vector<int>(recv.begin(), recv.end()) == piece);
+  }
+}
+
+TEST_CASE("Exchange pieces of different sizes between all ranks", "[comm]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  int n = comm.size;
+
+  // Rank r sends d + 1 values of 100 * r + d to rank d
+  std::vector<double> send;
+  std::vector<int> send_counts;
+  for (int d = 0; d < n; ++d) {
+    send.insert(send.end(), d + 1, 100.0 * comm.rank + d);
+    send_counts.push_back(d + 1);
+  }
+
+  std::vector<double> recv;
+  std::vector<int> recv_counts;
+  comm.alltoallv(send, send_counts, recv, recv_counts);
+
+  std::vector<double> expected;
+  for (int s = 0; s < n; ++s) {
+    expected.insert(expected.end(), comm.rank + 1, 100.0 * s + comm.rank);
+  }
+  CHECK(recv == expected);
+  CHECK(recv_counts == std::vector<int>(n, comm.rank + 1));
+}
@@ -0,0 +1,78 @@
+/**
+ * \file test_comm_counters.cpp
+ * \brief Unit tests for counting the communication of Comm.  They run on any number of
+ * ranks, and are meant to be run on more than one.
+ */
+
+#include "catch.hpp"
+#include "enrico/comm.h"
+#include "enrico/comm_counters.h"
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+using enrico::Comm;
+using enrico::comm_counters;
+
+TEST_CASE("Merge names that differ between ranks", "[comm_counters]")
+{
+  Comm comm{MPI_COMM_WORLD};
+
+  // Every rank has "common" and its own name, and only rank 0 has "a/b"
+  std::set<std::string> names{"common", "rank " + std::to_string(comm.rank)};
+  if (comm.rank == 0) {
+    names.insert("a/b");
+  }
+  auto merged = comm.union_names(names);
+
+  std::vector<std::string> expected{"a/b", "common"};
+  for (int r = 0; r < comm.size; ++r) {
+    expected.push_back("rank " + std::to_string(r));
+  }
+  std::sort(expected.begin(), expected.end());
+  CHECK(merged == expected);
+}
+
+TEST_CASE("Count calls and bytes of a broadcast", "[comm_counters]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  comm_counters.reset();
+  comm_counters.enable(true);
+
+  std::vector<double> values(4, comm.rank);
+  comm.broadcast(values);
+  comm.broadcast(values);
+
+  comm_counters.enable(false);
+  auto count = comm_counters.get("-", "broadcast");
+  comm_counters.reset();
+
+  // The broadcast of the size is counted as part of each broadcast of the vector, and
+  // only the root sends
+  CHECK(count.calls == 2);
+  if (comm.is_root()) {
+    CHECK(count.messages == 4);
+    CHECK(count.bytes == 2 * (sizeof(int) + 4 * sizeof(double)));
+  } else {
+    CHECK(count.messages == 0);
+    CHECK(count.bytes == 0);
+  }
+  CHECK(values == std::vector<double>(4, 0.0));
+}
+
+TEST_CASE("Nothing is counted until counting is enabled", "[comm_counters]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  comm_counters.reset();
+
+  int value = comm.rank;
+  comm.allreduce(value, MPI_SUM);
+
+  auto count = comm_counters.get("-", "allreduce");
+  CHECK(count.calls == 0);
+  CHECK(count.bytes == 0);
+}
@@ -0,0 +1,36 @@
+/**
+ * \file test_comm_split.cpp
+ * \brief Unit tests for choosing the nodes of each driver.
+ */
+
+#include "catch.hpp"
+#include "enrico/comm_split.h"
+
+TEST_CASE("Balance nodes between drivers", "[comm_split]")
+{
+  SECTION("Equal work splits the nodes evenly")
+  {
+    auto nodes = enrico::balance_nodes({10.0, 10.0}, 8);
+    CHECK(nodes[0] == 4);
+    CHECK(nodes[1] == 4);
+  }
+
+  SECTION("Nodes go as the square root of the work")
+  {
+    auto nodes = enrico::balance_nodes({90.0, 10.0}, 8);
+    CHECK(nodes[0] == 6);
+    CHECK(nodes[1] == 2);
+  }
+
+  SECTION("Each driver gets at least one node")
+  {
+    auto nodes = enrico::balance_nodes({1000.0, 0.0}, 4);
+    CHECK(nodes[0] == 3);
+    CHECK(nodes[1] == 1);
+  }
+
+  SECTION("Fewer than two nodes cannot be split")
+  {
+    CHECK_THROWS(enrico::balance_nodes({1.0, 1.0}, 1));
+  }
+}
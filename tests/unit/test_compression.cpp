@@ -0,0 +1,84 @@
+/**
+ * \file test_compression.cpp
+ * \brief Unit tests for compression of coupling fields.
+ */
+
+#include "catch.hpp"
+#include "enrico/compression.h"
+
+#include <cmath>
+#include <vector>
+
+TEST_CASE("Compress doubles relative to a reference", "[compression]")
+{
+  std::vector<double> prev{300.0, 310.5, 320.25, 330.125, 1.0e-3, -2.0};
+  std::vector<double> next{300.0, 310.5, 320.3, 330.125, 1.0e-3, -2.5};
+
+  SECTION("Round trip with a reference is exact and smaller")
+  {
+    auto bytes = enrico::compress(next.data(), next.size(), prev);
+    CHECK(bytes.size() < next.size() * sizeof(double));
+    CHECK(enrico::decompress(bytes, prev) == next);
+  }
+
+  SECTION("Round trip without a reference is exact")
+  {
+    auto bytes = enrico::compress(next.data(), next.size(), {});
+    CHECK(enrico::decompress(bytes, {}) == next);
+  }
+
+  SECTION("Empty arrays round trip")
+  {
+    std::vector<double> empty;
+    auto bytes = enrico::compress(empty.data(), 0, {});
+    CHECK(enrico::decompress(bytes, {}).empty());
+  }
+}
+
+TEST_CASE("Encode doubles at reduced precision", "[compression]")
+{
+  std::vector<double> values{300.0, 310.5, 320.25, 330.125, 450.0, 600.0};
+  double max_error;
+
+  SECTION("Full precision is exact")
+  {
+    auto bytes =
+      enrico::encode(values.data(), values.size(), enrico::Precision::full, max_error);
+    CHECK(max_error == 0.0);
+    CHECK(enrico::decode(bytes) == values);
+  }
+
+  SECTION("Single precision halves the size")
+  {
+    auto bytes =
+      enrico::encode(values.data(), values.size(), enrico::Precision::single, max_error);
+    CHECK(bytes.size() < values.size() * sizeof(double) / 2 + 16);
+    auto decoded = enrico::decode(bytes);
+    REQUIRE(decoded.size() == values.size());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      CHECK(std::abs(decoded[i] - values[i]) <= max_error);
+    }
+  }
+
+  SECTION("Fixed point is bounded by the range")
+  {
+    auto bytes =
+      enrico::encode(values.data(), values.size(), enrico::Precision::fixed, max_error);
+    CHECK(max_error <= 0.5 * (600.0 - 300.0) / 65535 * (1.0 + 1.0e-9));
+    auto decoded = enrico::decode(bytes);
+    REQUIRE(decoded.size() == values.size());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      CHECK(std::abs(decoded[i] - values[i]) <= max_error);
+    }
+    CHECK(decoded.front() == values.front());
+  }
+
+  SECTION("Constant arrays are exact in fixed point")
+  {
+    std::vector<double> constant(4, 2.5);
+    auto bytes = enrico::encode(
+      constant.data(), constant.size(), enrico::Precision::fixed, max_error);
+    CHECK(max_error == 0.0);
+    CHECK(enrico::decode(bytes) == constant);
+  }
+}
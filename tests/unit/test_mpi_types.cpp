@@ -0,0 +1,137 @@
+/**
+ * \file test_mpi_types.cpp
+ * \brief Unit tests for sending records and strided views with derived MPI datatypes.
+ * They run on any number of ranks, and are meant to be run on more than one.
+ */
+
+#include "catch.hpp"
+#include "enrico/cell_record.h"
+#include "enrico/comm.h"
+#include "enrico/mpi_types.h"
+
+#include <mpi.h>
+#include <xtensor/xtensor.hpp>
+#include <xtensor/xview.hpp>
+
+#include <cstddef>
+#include <vector>
+
+using enrico::CellHandle;
+using enrico::CellRecord;
+using enrico::Comm;
+
+TEST_CASE("Send cell records", "[mpi_types]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  int source = comm.size - 1;
+  std::size_t n = comm.size;
+
+  // The last rank sends one record per rank, each with distinct fields
+  std::vector<CellRecord> sent;
+  if (comm.rank == source) {
+    for (int i = 0; i < comm.size; ++i) {
+      CellRecord record;
+      record.cell = 1000 + i;
+      record.value = 300.0 + i;
+      record.volume = 0.5 * i;
+      record.fluid = i % 2;
+      sent.push_back(record);
+    }
+  }
+
+  SECTION("Point to point")
+  {
+    std::vector<CellRecord> received;
+    comm.send_and_recv_probed(received, 0, sent, source);
+    if (comm.rank == 0) {
+      REQUIRE(received.size() == n);
+      for (int i = 0; i < comm.size; ++i) {
+        CHECK(received[i].cell == CellHandle(1000 + i));
+        CHECK(received[i].value == 300.0 + i);
+        CHECK(received[i].volume == 0.5 * i);
+        CHECK(received[i].fluid == i % 2);
+      }
+    }
+  }
+
+  SECTION("Broadcast")
+  {
+    comm.broadcast(sent, source);
+    REQUIRE(sent.size() == n);
+    const auto& mine = sent[comm.rank];
+    CHECK(mine.cell == CellHandle(1000 + comm.rank));
+    CHECK(mine.value == 300.0 + comm.rank);
+    CHECK(mine.volume == 0.5 * comm.rank);
+    CHECK(mine.fluid == comm.rank % 2);
+  }
+}
+
+TEST_CASE("Send strided values", "[mpi_types]")
+{
+  Comm comm{MPI_COMM_WORLD};
+  int source = comm.size - 1;
+  const int rows = 4;
+  const int cols = 3;
+
+  SECTION("Column of a row-major array")
+  {
+    // Each rank receives column 1 of the source's array into column 2 of its own
+    std::vector<double> values(rows * cols, 0.0);
+    if (comm.rank == source) {
+      for (int i = 0; i < rows * cols; ++i) {
+        values[i] = i;
+      }
+    }
+    auto column = enrico::get_mpi_strided_type<double>(rows, 1, cols);
+    if (comm.rank == source) {
+      MPI_Bcast(&values[1], 1, column, source, comm.comm);
+    } else {
+      MPI_Bcast(&values[2], 1, column, source, comm.comm);
+    }
+
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        double expected;
+        if (comm.rank == source) {
+          expected = i * cols + j;
+        } else {
+          expected = j == 2 ? i * cols + 1 : 0.0;
+        }
+        CHECK(values[i * cols + j] == expected);
+      }
+    }
+
+    // The same arguments give the same cached datatype
+    CHECK(enrico::get_mpi_strided_type<double>(rows, 1, cols) == column);
+  }
+
+  SECTION("View of an xtensor")
+  {
+    // The source sends column 1 of its tensor, which arrives contiguous
+    using Shape = xt::xtensor<double, 2>::shape_type;
+    xt::xtensor<double, 2> tensor(Shape{rows, cols}, 0.0);
+    std::vector<double> received(rows);
+    if (comm.rank == source) {
+      for (int i = 0; i < rows * cols; ++i) {
+        tensor.data()[i] = i;
+      }
+    }
+    auto view = xt::view(tensor, xt::all(), 1);
+
+    if (comm.rank == source) {
+      auto type = enrico::get_mpi_view_type(view);
+      std::vector<MPI_Request> requests(comm.size);
+      for (int r = 0; r < comm.size; ++r) {
+        MPI_Isend(&view(0), 1, type, r, 0, comm.comm, &requests[r]);
+      }
+      MPI_Recv(received.data(), rows, MPI_DOUBLE, source, 0, comm.comm, MPI_STATUS_IGNORE);
+      MPI_Waitall(comm.size, requests.data(), MPI_STATUSES_IGNORE);
+    } else {
+      MPI_Recv(received.data(), rows, MPI_DOUBLE, source, 0, comm.comm, MPI_STATUS_IGNORE);
+    }
+
+    for (int i = 0; i < rows; ++i) {
+      CHECK(received[i] == i * cols + 1);
+    }
+  }
+}
@@ -0,0 +1,127 @@
+/**
+ * \file test_pin_expansion.cpp
+ * \brief Unit tests for functional expansions of the heat source in pins.
+ */
+
+#include "catch.hpp"
+#include "enrico/pin_expansion.h"
+
+#include <xtensor/xtensor.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using enrico::PinExpansion;
+using enrico::Position;
+
+using Shape = xt::xtensor<double, 1>::shape_type;
+
+TEST_CASE("Evaluate Zernike and Legendre polynomials", "[pin_expansion]")
+{
+  SECTION("Zernike polynomials are ordered and normalized as in OpenMC")
+  {
+    auto z = enrico::zernike(2, 0.5, 0.3);
+    REQUIRE(z.size() == 6);
+    CHECK(z[0] == Approx(1.0));
+    CHECK(z[1] == Approx(2.0 * 0.5 * std::sin(0.3)));
+    CHECK(z[2] == Approx(2.0 * 0.5 * std::cos(0.3)));
+    CHECK(z[4] == Approx(std::sqrt(3.0) * (2.0 * 0.25 - 1.0)));
+  }
+
+  SECTION("Zernike polynomials are orthogonal on the unit disk")
+  {
+    // Midpoint rule in rho and phi
+    const int n_rho = 200;
+    const int n_phi = 200;
+    std::vector<double> products(10 * 10, 0.0);
+    for (int i = 0; i < n_rho; ++i) {
+      double rho = (i + 0.5) / n_rho;
+      for (int j = 0; j < n_phi; ++j) {
+        double phi = 2.0 * M_PI * (j + 0.5) / n_phi;
+        auto z = enrico::zernike(3, rho, phi);
+        for (int a = 0; a < 10; ++a) {
+          for (int b = 0; b < 10; ++b) {
+            products[10 * a + b] += z[a] * z[b] * rho / n_rho * 2.0 * M_PI / n_phi;
+          }
+        }
+      }
+    }
+    for (int a = 0; a < 10; ++a) {
+      for (int b = 0; b < 10; ++b) {
+        CHECK(products[10 * a + b] == Approx(a == b ? M_PI : 0.0).margin(1e-3));
+      }
+    }
+  }
+
+  SECTION("Legendre polynomials follow the recurrence")
+  {
+    auto p = enrico::legendre(3, 0.5);
+    REQUIRE(p.size() == 4);
+    CHECK(p[0] == Approx(1.0));
+    CHECK(p[1] == Approx(0.5));
+    CHECK(p[2] == Approx(0.5 * (3.0 * 0.25 - 1.0)));
+    CHECK(p[3] == Approx(0.5 * (5.0 * 0.125 - 3.0 * 0.5)));
+  }
+}
+
+TEST_CASE("Reconstruct a heat source from pin moments", "[pin_expansion]")
+{
+  PinExpansion pins{{{0.0, 0.0}, {2.0, 0.0}}, 0.5, 0.0, 10.0, 2, 2};
+  REQUIRE(pins.n_coefficients() == 18);
+  REQUIRE(pins.size() == 36);
+
+  SECTION("Positions are found in pins")
+  {
+    CHECK(pins.pin({0.1, 0.1, 5.0}) == 0);
+    CHECK(pins.pin({2.3, 0.0, 5.0}) == 1);
+    CHECK(pins.pin({1.0, 0.0, 5.0}) == -1);
+    CHECK(pins.pin({0.0, 0.0, 11.0}) == -1);
+  }
+
+  SECTION("Moments of a linear source give it back")
+  {
+    // q(x, y, z) = 3 + x + 0.2 z in the second pin, whose moments are integrated with
+    // the midpoint rule in cylindrical coordinates
+    auto q = [](const Position& r) { return 3.0 + (r.x - 2.0) + 0.2 * r.z; };
+    std::vector<double> moments(pins.size(), 0.0);
+    const int n = 40;
+    for (int i = 0; i < n; ++i) {
+      double s = 0.5 * (i + 0.5) / n;
+      for (int j = 0; j < n; ++j) {
+        double phi = 2.0 * M_PI * (j + 0.5) / n;
+        for (int k = 0; k < n; ++k) {
+          Position r{2.0 + s * std::cos(phi), s * std::sin(phi), 10.0 * (k + 0.5) / n};
+          double dV = s * (0.5 / n) * (2.0 * M_PI / n) * (10.0 / n);
+          std::vector<gsl::index> indices;
+          std::vector<double> weights;
+          pins.weights(r, indices, weights);
+          for (gsl::index m = 0; m < indices.size(); ++m) {
+            moments[indices[m]] += q(r) * weights[m] * dV;
+          }
+        }
+      }
+    }
+    for (gsl::index m = 0; m < moments.size(); ++m) {
+      moments[m] *= pins.coefficient_scale(m % pins.n_coefficients());
+    }
+
+    for (const auto& r : {Position{2.1, 0.2, 3.0}, Position{1.7, -0.1, 8.0}}) {
+      std::vector<gsl::index> indices;
+      std::vector<double> weights;
+      pins.weights(r, indices, weights);
+      double value = 0.0;
+      for (gsl::index m = 0; m < indices.size(); ++m) {
+        value += moments[indices[m]] * weights[m];
+      }
+      CHECK(value == Approx(q(r)).epsilon(1e-2));
+    }
+
+    // Only the second pin has a heat source, whose integral is the average of q,
+    // 3 + 0.2 * 5, times the volume of the pin
+    xt::xtensor<double, 1> values(Shape{moments.size()}, 0.0);
+    std::copy(moments.begin(), moments.end(), values.begin());
+    double volume = M_PI * 0.5 * 0.5 * 10.0;
+    CHECK(pins.integral(values) == Approx(4.0 * volume).epsilon(1e-2));
+  }
+}
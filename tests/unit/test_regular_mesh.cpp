@@ -0,0 +1,61 @@
+/**
+ * \file test_regular_mesh.cpp
+ * \brief Unit tests for the mesh on which a heat source can be tallied.
+ */
+
+#include "catch.hpp"
+#include "enrico/regular_mesh.h"
+
+#include <xtensor/xtensor.hpp>
+
+#include <stdexcept>
+
+using enrico::Position;
+using enrico::RegularMesh;
+
+TEST_CASE("Find bins of a regular mesh", "[regular_mesh]")
+{
+  RegularMesh mesh{{-1.0, -1.0, 0.0}, {1.0, 1.0, 10.0}, {2, 2, 5}};
+
+  SECTION("Bins are numbered with x fastest")
+  {
+    CHECK(mesh.bin({-0.5, -0.5, 1.0}) == 0);
+    CHECK(mesh.bin({0.5, -0.5, 1.0}) == 1);
+    CHECK(mesh.bin({-0.5, 0.5, 1.0}) == 2);
+    CHECK(mesh.bin({0.5, 0.5, 9.0}) == 19);
+  }
+
+  SECTION("The upper boundary belongs to the last bin")
+  {
+    CHECK(mesh.bin({1.0, 1.0, 10.0}) == 19);
+    CHECK(mesh.bin({-1.0, -1.0, 0.0}) == 0);
+  }
+
+  SECTION("Positions outside the mesh have no bin")
+  {
+    CHECK(mesh.bin({1.5, 0.0, 5.0}) == -1);
+    CHECK(mesh.bin({0.0, 0.0, -0.1}) == -1);
+  }
+
+  SECTION("Bins divide the volume equally")
+  {
+    CHECK(mesh.n_bins() == 20);
+    CHECK(mesh.bin_volume() == Approx(2.0));
+  }
+
+  SECTION("The power is the heat source summed over the bins")
+  {
+    using Shape = xt::xtensor<double, 1>::shape_type;
+    xt::xtensor<double, 1> values(Shape{mesh.n_bins()}, 0.5);
+    values[19] = 3.0;
+    CHECK(mesh.integral(values) == Approx((19 * 0.5 + 3.0) * 2.0));
+  }
+}
+
+TEST_CASE("Reject invalid regular meshes", "[regular_mesh]")
+{
+  CHECK_THROWS_AS(RegularMesh({1.0, 0.0, 0.0}, {0.0, 1.0, 1.0}, {1, 1, 1}),
+                  std::runtime_error);
+  CHECK_THROWS_AS(RegularMesh({0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {1, 0, 1}),
+                  std::runtime_error);
+}
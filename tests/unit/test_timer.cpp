@@ -0,0 +1,85 @@
+/**
+ * \file test_timer.cpp
+ * \brief Unit tests for reading timer reports.
+ */
+
+#include "catch.hpp"
+#include "enrico/comm.h"
+#include "enrico/timer.h"
+
+#include <mpi.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using enrico::TimeAmt;
+
+namespace {
+
+//! Captures what is printed to std::cout while it is alive
+class CaptureCout {
+public:
+  CaptureCout()
+    : old_(std::cout.rdbuf(out_.rdbuf()))
+  {}
+  ~CaptureCout() { std::cout.rdbuf(old_); }
+  std::string str() const { return out_.str(); }
+
+private:
+  std::stringstream out_;
+  std::streambuf* old_;
+};
+
+//! Make a time with a given smallest and average time over ranks
+TimeAmt make_time(const std::string& name, double time, double percent, double min)
+{
+  TimeAmt t{name, time, percent};
+  t.min = min;
+  t.avg = 0.5 * (min + time);
+  t.slowest = 1;
+  return t;
+}
+
+} // namespace
+
+TEST_CASE("Read times from a timer report", "[timer]")
+{
+  // Each rank prints its own report
+  enrico::Comm self{MPI_COMM_SELF};
+
+  std::string report;
+  {
+    CaptureCout capture;
+    std::vector<TimeAmt> neut{make_time("solve_step", 1.0, 0.1, 0.5)};
+    std::vector<TimeAmt> heat{make_time("solve_step", 2.0, 0.2, 1.5)};
+    TimeAmt::print_times("NeutronicsDriver", neut, self);
+    TimeAmt::print_imbalance("NeutronicsDriver", neut, self);
+    TimeAmt::print_times("HeatFluidsDriver", heat, self);
+
+    self.message("Cumulative times at i_timestep = 0 , i_picard = 1");
+    std::vector<TimeAmt> cumulative{make_time("init_step", 0.5, 0.05, 0.25),
+                                    make_time("solve_step", 3.0, 0.3, 2.5)};
+    TimeAmt::print_times("NeutronicsDriver", cumulative, self);
+    TimeAmt::print_imbalance("NeutronicsDriver", cumulative, self);
+    TimeAmt::print_times("HeatFluidsDriver", heat, self);
+    report = capture.str();
+  }
+  REQUIRE(report.find("(seconds, percent, min, avg)") != std::string::npos);
+
+  std::istringstream is{report};
+  auto times = TimeAmt::read_times(is, "NeutronicsDriver");
+  REQUIRE(times.size() == 2);
+  CHECK(times[0].name == "init_step");
+  CHECK(times[0].time == Approx(0.5));
+  CHECK(times[1].name == "solve_step");
+  CHECK(times[1].time == Approx(3.0));
+  CHECK(times[1].percent == Approx(0.3));
+
+  is.clear();
+  is.seekg(0);
+  times = TimeAmt::read_times(is, "HeatFluidsDriver");
+  REQUIRE(times.size() == 1);
+  CHECK(times[0].time == Approx(2.0));
+}